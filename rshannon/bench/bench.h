@@ -0,0 +1,100 @@
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+/**
+ * Minimal microbenchmark harness shared by the bench_* programs.
+ *
+ * A case is a setup function, run untimed, and an operation, timed, that
+ * returns how many elementary operations it performed. bench_sizes()
+ * runs a case over the standard window sizes, repeating each size until
+ * BENCH_BUDGET_NS of timed work has been done. Each result is printed as
+ * one JSON object per line.
+ *
+ * Once a single timed call takes longer than BENCH_SKIP_NS, the larger
+ * sizes are reported as skipped: a structure that has stopped scaling
+ * would take minutes there, and the skip itself is the finding.
+ */
+
+#define BENCH_BUDGET_NS 200000000ULL // Timed work per size
+#define BENCH_SKIP_NS 50000000ULL    // Single call that stops the sweep
+#define BENCH_BATCH 1000              // Operations per timed call, at most
+
+typedef void (*bench_setup_fn)(int n);
+typedef uint64_t (*bench_op_fn)(int n);
+
+static const int bench_window_sizes[] = {10, 100, 1000, 10000, 100000};
+#define BENCH_NSIZES (sizeof(bench_window_sizes) / sizeof(int))
+
+static inline uint64_t bench_now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Run one case at one size and print its result.
+ *
+ * @return the longest single timed call, in nanoseconds
+ */
+static inline uint64_t bench_run(const char *suite, const char *name,
+                                 int n, bench_setup_fn setup,
+                                 bench_op_fn op) {
+  uint64_t total_ns = 0, total_ops = 0, worst_ns = 0, calls = 0;
+
+  while (total_ns < BENCH_BUDGET_NS) {
+    if (setup != NULL) {
+      setup(n);
+    }
+    uint64_t start = bench_now_ns();
+    uint64_t ops = op(n);
+    uint64_t elapsed = bench_now_ns() - start;
+    total_ns += elapsed;
+    total_ops += ops;
+    calls++;
+    if (elapsed > worst_ns) {
+      worst_ns = elapsed;
+    }
+    if (elapsed > BENCH_SKIP_NS) {
+      break;
+    }
+  }
+  printf("{\"suite\": \"%s\", \"benchmark\": \"%s\", \"n\": %d, "
+         "\"calls\": %llu, \"ops\": %llu, \"ns_per_op\": %.3f, "
+         "\"worst_call_ns\": %llu}\n",
+         suite, name, n, (unsigned long long)calls,
+         (unsigned long long)total_ops,
+         total_ops > 0 ? (double)total_ns / total_ops : 0.0,
+         (unsigned long long)worst_ns);
+  fflush(stdout);
+  return worst_ns;
+}
+
+/**
+ * Run a case over every window size, skipping the rest once it stops
+ * scaling.
+ */
+static inline void bench_sizes(const char *suite, const char *name,
+                               bench_setup_fn setup, bench_op_fn op) {
+  bool skipping = false;
+  for (unsigned i = 0; i < BENCH_NSIZES; i++) {
+    int n = bench_window_sizes[i];
+    if (skipping) {
+      printf("{\"suite\": \"%s\", \"benchmark\": \"%s\", \"n\": %d, "
+             "\"skipped\": true}\n",
+             suite, name, n);
+      continue;
+    }
+    skipping = bench_run(suite, name, n, setup, op) > BENCH_SKIP_NS;
+  }
+}
+
+/**
+ * Keep the compiler from optimising a result away.
+ */
+static volatile uint64_t bench_sink;
+
+#endif
@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <vector>
+
+#include "../include/gbn.h"
+#include "bench.h"
+
+using namespace gbn;
+
+/**
+ * Microbenchmarks for the Go-Back-N sender: checksum, cumulative_ack and
+ * fill_sender_window with a window of n packets. The protocol runs
+ * against the stub simulator API, so only its own bookkeeping is timed.
+ */
+
+static struct pkt packet_for(int seq_num) {
+  struct pkt packet = {};
+  packet.seqnum = seq_num;
+  packet.checksum = checksum(packet);
+  return packet;
+}
+
+/**
+ * Packets per call; the window size only matters to the other cases.
+ */
+static uint64_t op_checksum(int n) {
+  struct pkt packet = {};
+  int sum = 0;
+  for (int i = 0; i < n; i++) {
+    packet.seqnum = i;
+    sum += checksum(packet);
+  }
+  bench_sink += sum;
+  return n;
+}
+
+/**
+ * n + BENCH_BATCH packets outstanding, so the window never drops below n
+ * while the batch is being acknowledged.
+ */
+static void setup_cumulative_ack(int n) {
+  unacked_buf.clear();
+  for (int i = 1; i <= n + BENCH_BATCH; i++) {
+    unacked_buf.push_back(packet_for(i));
+  }
+  window_size = n + BENCH_BATCH;
+  base = 1;
+}
+
+/**
+ * Acknowledge the outstanding packets one at a time, oldest first.
+ */
+static uint64_t op_cumulative_ack(int n) {
+  for (int i = 0; i < BENCH_BATCH; i++) {
+    cumulative_ack(i + 2);
+  }
+  return BENCH_BATCH;
+}
+
+/**
+ * A window of n with a batch's worth of room in it, and n packets queued
+ * behind it.
+ */
+static void setup_fill_sender_window(int n) {
+  int room = n < BENCH_BATCH ? n : BENCH_BATCH;
+  unacked_buf.clear();
+  unsent_buf.clear();
+  for (int i = 1; i <= n - room; i++) {
+    unacked_buf.push_back(packet_for(i));
+  }
+  for (int i = n - room + 1; i <= 2 * n - room; i++) {
+    unsent_buf.push_back(packet_for(i));
+  }
+  window_size = n;
+}
+
+/**
+ * Send as much of the queue as the window allows.
+ */
+static uint64_t op_fill_sender_window(int n) {
+  fill_sender_window();
+  return n < BENCH_BATCH ? n : BENCH_BATCH;
+}
+
+int main(int argc, char **argv) {
+  bench_sizes("gbn", "checksum", NULL, op_checksum);
+  bench_sizes("gbn", "cumulative_ack", setup_cumulative_ack,
+              op_cumulative_ack);
+  bench_sizes("gbn", "fill_sender_window", setup_fill_sender_window,
+              op_fill_sender_window);
+  return 0;
+}
@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "../include/simulator.h"
+#include "bench.h"
+
+/**
+ * Scaling benchmark for the partitioned event loop (rdt -j).
+ *
+ * Each protocol's run is simulated once with the original sequential
+ * loop (threads 0) and then partitioned on 1 to PDES_LPS threads. Every
+ * run is a child process calling the emulator's main, as the emulator
+ * keeps its state in globals; it reports back its wall time, the events
+ * it simulated and its counters. A partitioned run must come out the
+ * same on any number of threads, and "same" says whether it did.
+ *
+ * Speedups are over the partitioned run on one thread. There is one LP
+ * per host, so more threads than PDES_LPS have nothing to run, and none
+ * of it helps on fewer cores than threads ("cores" is how many the
+ * machine has online).
+ */
+
+#define PDES_LPS 2 // A and B
+
+int simulator_main(int argc, char **argv);
+extern thread_local unsigned long long nsimevents;
+extern thread_local float time_local;
+extern double profwall;
+extern int A_transport;
+extern int B_application;
+
+/**
+ * What a run reports back to the benchmark.
+ */
+struct outcome {
+  double wall;
+  unsigned long long events;
+  int A_transport;
+  int B_application;
+  float time;
+};
+
+static const char *protocols[] = {"abt", "gbn", "sr"};
+
+/**
+ * Simulate protocol with the given number of threads (0 for the original
+ * loop) in a child process, its report thrown away.
+ */
+static bool run(const char *protocol, int threads, struct outcome *out) {
+  int fds[2];
+  if (pipe(fds) < 0) {
+    perror("pipe");
+    return false;
+  }
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid < 0) {
+    perror("fork");
+    return false;
+  }
+  if (pid == 0) {
+    char proto[16], nthreads[16];
+    snprintf(proto, sizeof(proto), "%s", protocol);
+    snprintf(nthreads, sizeof(nthreads), "%d", threads);
+    char *argv[] = {(char *)"rdt", (char *)"-P", proto, (char *)"-s",
+                    (char *)"1", (char *)"-w", (char *)"50", (char *)"-m",
+                    (char *)"20000", (char *)"-l", (char *)"0.2", (char *)"-c",
+                    (char *)"0.2", (char *)"-t", (char *)"50", (char *)"-v",
+                    (char *)"0", (char *)"-j", nthreads, NULL};
+    int argc = sizeof(argv) / sizeof(argv[0]) - 1;
+    if (threads == 0) {
+      argc -= 2;
+      argv[argc] = NULL;
+    }
+    int devnull = open("/dev/null", O_WRONLY);
+    dup2(devnull, STDOUT_FILENO);
+    close(fds[0]);
+    int status = simulator_main(argc, argv);
+    fflush(stdout);
+    struct outcome o = {profwall, nsimevents, A_transport, B_application,
+                        time_local};
+    bool ok = status == 0 && write(fds[1], &o, sizeof(o)) == sizeof(o);
+    _exit(ok ? 0 : 1);
+  }
+  close(fds[1]);
+  bool ok = read(fds[0], out, sizeof(*out)) == sizeof(*out);
+  close(fds[0]);
+  int status;
+  waitpid(pid, &status, 0);
+  return ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+int main(int argc, char **argv) {
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+
+  for (unsigned i = 0; i < sizeof(protocols) / sizeof(protocols[0]); i++) {
+    struct outcome one = {};
+    for (int threads = 0; threads <= PDES_LPS; threads++) {
+      struct outcome o;
+      if (!run(protocols[i], threads, &o)) {
+        fprintf(stderr, "%s with %d threads failed\n", protocols[i], threads);
+        return 1;
+      }
+      if (threads == 1) {
+        one = o;
+      }
+      printf("{\"suite\": \"pdes\", \"benchmark\": \"%s\", \"threads\": %d, "
+             "\"cores\": %ld, \"events\": %llu, \"seconds\": %.3f, "
+             "\"events_per_sec\": %.0f",
+             protocols[i], threads, cores, o.events, o.wall,
+             o.wall > 0 ? o.events / o.wall : 0.0);
+      if (threads > 0) {
+        printf(", \"speedup\": %.3f, \"same\": %s", one.wall / o.wall,
+               o.events == one.events && o.A_transport == one.A_transport &&
+                       o.B_application == one.B_application &&
+                       o.time == one.time
+                   ? "true"
+                   : "false");
+      }
+      printf("}\n");
+      fflush(stdout);
+    }
+  }
+  return 0;
+}
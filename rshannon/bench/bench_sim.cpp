@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../include/simulator.h"
+#include "../include/event.h"
+#include "bench.h"
+
+/**
+ * Microbenchmarks for the emulator's event list: insertevent,
+ * starttimer/stoptimer and tolayer3, each with n events already pending.
+ *
+ * The emulator is linked in whole (its main renamed), so the code
+ * measured is exactly the code the simulator binaries run. The protocols
+ * are linked in only to satisfy its registry; nothing here calls them.
+ */
+
+extern int TRACE;
+extern thread_local float time_local;
+extern float lossprob;
+extern float corruptprob;
+extern float lastarrival[2];
+
+/**
+ * Free every pending event.
+ */
+static void clear_events() {
+  while (evlist != EVNIL) {
+    evidx next = eventat(evlist)->next;
+    freeevent(evlist);
+    evlist = next;
+  }
+}
+
+/**
+ * Replace the event list with n packet arrivals at B, one per time unit,
+ * built directly in order rather than through insertevent.
+ */
+static void fill_events(int n) {
+  evidx tail = EVNIL;
+
+  clear_events();
+  time_local = 0;
+  for (int i = 0; i < n; i++) {
+    evidx id = newevent();
+    struct event *p = eventat(id);
+    p->evtime = i + 1;
+    p->evtype = FROM_LAYER3;
+    p->eventity = B;
+    p->sendidx = i;
+    p->prev = tail;
+    p->next = EVNIL;
+    if (tail == EVNIL) {
+      evlist = id;
+    } else {
+      eventat(tail)->next = id;
+    }
+    tail = id;
+  }
+  lastarrival[B] = n;
+}
+
+/**
+ * Hold model: take the earliest event and reschedule it a random time
+ * into the future, keeping the list at n events.
+ */
+static uint64_t op_insertevent(int n) {
+  for (int i = 0; i < BENCH_BATCH; i++) {
+    evidx id = evlist;
+    struct event *p = eventat(id);
+    evlist = p->next;
+    if (evlist != EVNIL) {
+      eventat(evlist)->prev = EVNIL;
+    }
+    time_local = p->evtime;
+    p->evtime = time_local + (float)n * rand() / RAND_MAX;
+    insertevent(id);
+  }
+  return BENCH_BATCH;
+}
+
+/**
+ * Start A's timer and cancel it again. Both walk the whole list looking
+ * for an existing timer.
+ */
+static uint64_t op_timer(int n) {
+  for (int i = 0; i < BENCH_BATCH; i++) {
+    starttimer(A, 0.5 * n);
+    stoptimer(A);
+  }
+  return BENCH_BATCH;
+}
+
+/**
+ * Hand packets to the medium. Each is due after every packet already in
+ * flight, so it is inserted at the tail; the list grows from n to
+ * n + BENCH_BATCH over the call.
+ */
+static uint64_t op_tolayer3(int n) {
+  struct pkt packet = {};
+  for (int i = 0; i < BENCH_BATCH; i++) {
+    packet.seqnum = i;
+    tolayer3(A, packet);
+  }
+  return BENCH_BATCH;
+}
+
+int main(int argc, char **argv) {
+  TRACE = 0;
+  lossprob = 0.0;
+  corruptprob = 0.0;
+  srand(1);
+
+  bench_sizes("simulator", "insertevent", fill_events, op_insertevent);
+  bench_sizes("simulator", "starttimer_stoptimer", fill_events, op_timer);
+  bench_sizes("simulator", "tolayer3", fill_events, op_tolayer3);
+  clear_events();
+  return 0;
+}
@@ -4,35 +4,41 @@
 #include "../include/simulator.h"
 #include <queue>
 
+/**
+ * Alternating Bit (ABT) protocol. Everything lives in namespace abt so
+ * it can be linked alongside the other protocols; see protocol.h.
+ */
+namespace abt {
+
 /**
  * Whether the most recently sent packet has been ACKed or not.
  */
-bool is_acked;
+extern bool is_acked;
 
 /**
  * The sequence number to use for outbound packets.
  */
-int current_seq_no;
+extern int current_seq_no;
 
 /**
  * The last received sequence number on the receiver side.
  */
-int last_recv_seq_no;
+extern int last_recv_seq_no;
 
 /**
  * Queued outbound messages from application.
  */
-std::queue<struct msg> msg_queue;
+extern std::queue<struct msg> msg_queue;
 
 /**
  * Buffer sent but unACKed packets.
  */
-struct pkt pkt_buf;
+extern struct pkt pkt_buf;
 
 /**
  * Number of packets sent (ignoring any resends due to timeouts).
  */
-int num_pkts_sent;
+extern int num_pkts_sent;
 
 /**
  * Alternate between 0 and 1.
@@ -46,4 +52,15 @@ int alternate_num(int n);
  * Packetize and send all queued messages.
  */
 void clear_msg_queue();
-#endif
\ No newline at end of file
+
+/**
+ * Packet helpers, as described in packet.h.
+ */
+int checksum(struct pkt packet);
+bool is_corrupt(struct pkt packet);
+pkt make_pkt(int seqnum, int acknum, struct msg message);
+void send_pkt(int caller, struct pkt packet);
+
+} // namespace abt
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef ANALYTIC_H_
+#define ANALYTIC_H_
+
+/**
+ * Analytic throughput models.
+ *
+ * A fast alternative to the emulator for exploring large parameter spaces,
+ * where ballpark throughput is enough. Each protocol is reduced to the
+ * emulator's channel and arrival processes:
+ *
+ * - A packet crosses the channel in 1 + 9U time units after the previous
+ *   packet in the same direction, so a round trip takes the sum of two
+ *   such delays and a saturated channel carries one packet per 5.5 time
+ *   units.
+ * - Each crossing is lost with probability lossprob and otherwise
+ *   corrupted with probability corruptprob; a corrupt packet always fails
+ *   the checksum.
+ * - Messages arrive at A with gaps drawn uniformly from [0, 2 * lambda],
+ *   and the run stops at the last of nsimmax arrivals.
+ *
+ * A message is sent again every timeout until one copy and its ACK both
+ * get through. The time this takes (the service time) and the number of
+ * copies sent follow from a small semi-Markov model of the retransmission
+ * attempts, integrated numerically. From there:
+ *
+ * - ABT drops messages that arrive while a packet is outstanding, so its
+ *   throughput is one message per renewal cycle of the arrival process
+ *   that covers a service time.
+ * - GBN and SR buffer every message, so they deliver the offered load
+ *   1/lambda unless they cannot carry it. SR is capped by its window
+ *   (window / service time) and the channel (channel capacity / copies
+ *   per message). GBN is modelled in rounds of outstanding packets that
+ *   drain through the channel, the receiver keeping those in order up to
+ *   the first loss and a timeout resending the rest.
+ *
+ * GBN is bistable: a full window can carry less than the load that filled
+ * it, and a run that gets there stays there. The estimate is for the
+ * uncongested state, with the throughput of the collapsed one reported
+ * alongside.
+ *
+ * The models describe the protocols as specified and the emulator as an
+ * ideal channel; the validation mode of the estimate tool shows where the
+ * implementations depart from them.
+ */
+
+/**
+ * Parameters of one estimate, as given to the emulator.
+ */
+struct analytic_params {
+  const char *protocol; // abt, gbn or sr
+  int window;
+  int messages;
+  double loss;
+  double corrupt;
+  double lambda;
+  double timeout;       // Retransmission timeout, 0 for the protocol's own
+};
+
+/**
+ * An estimate and the quantities it was derived from.
+ */
+struct analytic_estimate {
+  double throughput;    // Messages delivered per time unit, as [PA2] reports
+  double service_time;  // Mean time from first send to the ACK getting back
+  double transmissions; // Mean packets sent per delivered message
+  double capacity;      // Most the protocol can deliver per time unit
+  double collapse;      // Throughput once congested if that is stable, or 0
+  const char *bound;    // What limits the throughput
+};
+
+/**
+ * The retransmission timeout a protocol uses.
+ *
+ * @return the timeout, or 0 if there is no model for the protocol
+ */
+double analytic_timeout(const char *protocol);
+
+/**
+ * Estimate the throughput of one configuration.
+ *
+ * @return false if there is no model for the protocol
+ */
+bool analytic_run(const struct analytic_params *params,
+                  struct analytic_estimate *estimate);
+
+#endif
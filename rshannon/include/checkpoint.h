@@ -0,0 +1,63 @@
+#ifndef CHECKPOINT_H_
+#define CHECKPOINT_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+/**
+ * Simulation checkpoints.
+ *
+ * A checkpoint file holds the whole state of a run: the emulator's clock,
+ * counters, random number generator and event list, the per-message
+ * tracker, and the protocol's own state. It is written in host byte order
+ * and is only meant to be read back by the same build:
+ *
+ *   "CKPT" magic, u32 version, char[8] protocol name
+ *   emulator state, tracker state, protocol state
+ *
+ * Each part writes its own fields with the helpers below, and reads them
+ * back in the same order. Readers return false on a short or malformed
+ * file and leave reporting to the caller.
+ */
+#define CKPT_MAGIC "CKPT"
+#define CKPT_VERSION 8
+
+/**
+ * Write or read one plain value.
+ */
+template <class T> void ckpt_put(FILE *f, const T &value) {
+  fwrite(&value, sizeof(T), 1, f);
+}
+
+template <class T> bool ckpt_get(FILE *f, T &value) {
+  return fread(&value, sizeof(T), 1, f) == 1;
+}
+
+/**
+ * Write or read a sequence container (vector, deque) of plain values.
+ */
+template <class C> void ckpt_put_seq(FILE *f, const C &c) {
+  uint32_t n = c.size();
+  ckpt_put(f, n);
+  for (typename C::const_iterator it = c.begin(); it != c.end(); ++it) {
+    ckpt_put(f, *it);
+  }
+}
+
+template <class C> bool ckpt_get_seq(FILE *f, C &c) {
+  uint32_t n;
+  if (!ckpt_get(f, n)) {
+    return false;
+  }
+  c.clear();
+  for (uint32_t i = 0; i < n; i++) {
+    typename C::value_type value;
+    if (!ckpt_get(f, value)) {
+      return false;
+    }
+    c.push_back(value);
+  }
+  return true;
+}
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef EVENT_H_
+#define EVENT_H_
+
+#include <stdint.h>
+
+#include "../include/simulator.h"
+
+/* The emulator's event list, shared with tools (such as the benchmarks) */
+/* that drive the emulator's internals directly.                        */
+
+/* possible events: */
+#define  TIMER_INTERRUPT 0  
+#define  FROM_LAYER5     1
+#define  FROM_LAYER3     2
+#define  AT_ROUTER       3  /* packet reached a router of the topology (-T) */
+
+#define  OFF             0
+#define  ON              1
+#define   A    0
+#define   B    1
+
+
+/* Events live in an arena and are named by their 32-bit index there;   */
+/* the event list is linked by index too. What insertevent() reads as   */
+/* it walks the list (the time and the links) comes first, and a packet */
+/* in the medium is kept in its event rather than allocated apart.      */
+typedef uint32_t evidx;
+#define  EVNIL  0xffffffffu  /* no event, as at the end of the list */
+
+struct event {
+   float evtime;           /* event time */
+   uint16_t evtype;        /* event type code */
+   uint16_t eventity;      /* entity where event occurs */
+   evidx next;
+   evidx prev;
+   int sendidx;            /* order in which medium accepted pkt (if any) */
+   int node;               /* router an AT_ROUTER packet is at */
+   struct pkt pkt;         /* the packet (if any) */
+ };
+
+/* The arena is one array of events, doubled when it fills up. That     */
+/* moves it, so a pointer to an event is only good until the next       */
+/* newevent(); hold on to the index instead. Freed events go on a free  */
+/* list, to be handed out first.                                        */
+#define  ARENA_MIN       1024
+struct arena {
+   struct event *events;
+   uint32_t size;          /* events allocated */
+   uint32_t top;           /* events handed out of them so far */
+   evidx free;             /* freed events, linked through next */
+ };
+
+extern thread_local struct arena evarena; /* the events, and the event */
+extern thread_local evidx evlist; /* list, earliest first; the next    */
+                               /* message arrival is kept apart from it. */
+                               /* Each logical process of a partitioned  */
+                               /* run (-j) has its own.                  */
+
+/* the event at index i of an arena, or of evarena */
+static inline struct event *arenaat(const struct arena *a, evidx i)
+{
+   return &a->events[i];
+}
+
+static inline struct event *eventat(evidx i)
+{
+   return arenaat(&evarena, i);
+}
+
+/* take an event from evarena, and give one back */
+evidx newevent();
+void freeevent(evidx i);
+
+/* insert an event into the event list in time order */
+void insertevent(evidx i);
+
+#endif
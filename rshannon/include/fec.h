@@ -0,0 +1,121 @@
+#ifndef FEC_H_
+#define FEC_H_
+
+#include <stdint.h>
+#include <deque>
+
+#include "../include/simulator.h"
+#include "../include/packet.h"
+
+/**
+ * Forward error correction for the windowed protocols.
+ *
+ * Data packets are grouped into blocks of k consecutive sequence numbers
+ * (block b holds 1 + b*k to (b+1)*k). Once the sender has sent every
+ * packet of a block for the first time it follows them with r parity
+ * packets, and a receiver holding any k of the block's k + r packets can
+ * rebuild the rest without waiting for a retransmission.
+ *
+ * With r = 1 the parity is the XOR of the block's payloads. With more,
+ * parity packet j carries sum_i c(j, i) * payload_i over GF(2^8), with
+ * c a Cauchy matrix: every square submatrix of it is invertible, so any
+ * r losses in a block can be solved for, as with a Reed-Solomon erasure
+ * code.
+ *
+ * A parity packet has acknum FEC_PARITY(j, k, r) (data packets from A
+ * have acknum 0) and seqnum the first sequence number of its block, so a
+ * receiver ignores parity built with a block size it does not use.
+ */
+#define FEC_MAX_BLOCK 32  // Largest k
+#define FEC_MAX_PARITY 8  // Largest r
+#define FEC_MAX_BLOCKS 64 // Blocks a decoder keeps packets for
+
+#define FEC_PARITY(j, k, r) (-1 - ((j) + FEC_MAX_PARITY * ((r) + 256 * (k))))
+
+/**
+ * Sender side: the parity of the block being sent.
+ */
+struct fec_encoder {
+  int k;     // Data packets per block, 0 when FEC is off
+  int r;     // Parity packets per block
+  int block; // Block being encoded
+  int count; // Packets of it encoded so far, in order
+  unsigned char parity[FEC_MAX_PARITY][MSG_LEN];
+};
+
+/**
+ * Receiver side: what has arrived of one block.
+ */
+struct fec_block {
+  int block;
+  uint32_t received; // Bit i: data packet i is held
+  uint32_t checks;   // Bit j: parity packet j is held
+  unsigned char data[FEC_MAX_BLOCK][MSG_LEN];
+  unsigned char parity[FEC_MAX_PARITY][MSG_LEN];
+};
+
+/**
+ * Receiver side: the blocks still being received, oldest first.
+ */
+struct fec_decoder {
+  int k;
+  int r;
+  std::deque<fec_block> blocks;
+};
+
+/**
+ * Parity packets sent and data packets rebuilt, over every protocol
+ * instance in the process.
+ */
+extern int fec_parity_sent;
+extern int fec_recovered;
+
+/**
+ * Set up an encoder or decoder for blocks of k data and r parity
+ * packets, clamped to FEC_MAX_BLOCK and FEC_MAX_PARITY. k = 0 or r = 0
+ * turns FEC off.
+ */
+void fec_encoder_init(struct fec_encoder *e, int k, int r);
+void fec_decoder_init(struct fec_decoder *d, int k, int r);
+
+/**
+ * Pick up a new block size, starting both sides afresh if it changed.
+ */
+void fec_reconfigure(struct fec_encoder *e, struct fec_decoder *d, int k,
+                     int r);
+
+/**
+ * Whether a packet is an FEC parity packet.
+ */
+bool fec_is_parity(struct pkt packet);
+
+/**
+ * Add the first transmission of a data packet to the block being
+ * encoded. Packets must be added in sequence order; one out of order
+ * abandons the block it lands in.
+ *
+ * @param  parity set to the block's parity packets, checksums not filled
+ *                in, when packet completes a block
+ * @return        the number of parity packets to send, r or 0
+ */
+int fec_encode(struct fec_encoder *e, struct pkt packet, struct pkt *parity);
+
+/**
+ * Add an intact packet, data or parity, to its block, and rebuild the
+ * block's missing data packets if enough of it is now held.
+ *
+ * @param  out set to the rebuilt data packets, acknum 0 and checksums not
+ *             filled in
+ * @return     the number of packets rebuilt, at most FEC_MAX_PARITY
+ */
+int fec_decode(struct fec_decoder *d, struct pkt packet, struct pkt *out);
+
+/**
+ * Look up a data packet the decoder holds, received or rebuilt.
+ *
+ * @param  out set to the packet, checksum not filled in
+ * @return     false if it is not held
+ */
+bool fec_lookup(const struct fec_decoder *d, int seqnum, struct pkt *out);
+
+#endif
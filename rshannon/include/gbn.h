@@ -2,8 +2,16 @@
 #define GBN_H_
 
 #include "../include/simulator.h"
+#include "../include/fec.h"
+#include <deque>
 #include <queue>
 
+/**
+ * Go-Back-N (GBN) protocol. Everything lives in namespace gbn so
+ * it can be linked alongside the other protocols; see protocol.h.
+ */
+namespace gbn {
+
 /**
  * The maximum amount of packets that the sender store in
  * a single buffer.
@@ -13,19 +21,19 @@
  /**
   * Buffer containing all unacknowledged packets.
   */
- std::vector<struct pkt> unacked_buf;
+ extern std::vector<struct pkt> unacked_buf;
 
  /**
   * Buffer containing all packets ready to be sent out
   * as soon as they are within the send window.
   */
- std::vector<struct pkt> unsent_buf;
+ extern std::vector<struct pkt> unsent_buf;
 
  /**
   * Fire timer every X time units. This is a function
   * of the window size -- timer_interval = 5 * window_size
   */
- float timer_interval;
+ extern float timer_interval;
 
 /**
  * Helper methods to add a packet to a buffer.
@@ -61,10 +69,30 @@ bool sort_by_seq(const pkt& a, const pkt& b);
  * 4. [base+win_size, upper_limit(seq_num_space_size)] - packets that cannot be sent
  *    because they are outside of the window size.
  */
-int base;
-int next_seq_num;
-int window_size;
-int expected_seq_num;
+extern int base;
+extern int next_seq_num;
+extern int window_size;
+extern int expected_seq_num;
+
+/**
+ * Receiver-advertised window. B's receive buffer holds window_size
+ * messages, counting those delivered to its application but not yet read
+ * (see getunread()), and every ACK carries the room left in it as an int
+ * at the start of its payload. A keeps the latest value in rwnd and never
+ * has more than min(window_size, rwnd) packets outstanding; B drops data
+ * it has no room for. While the window is closed with nothing in flight,
+ * A's timer sends the next waiting packet as a probe.
+ */
+extern int rwnd;
+int usable_window();
+int receive_room();
+
+/**
+ * Packet helpers, as described in packet.h.
+ */
+int checksum(struct pkt packet);
+bool is_corrupt(struct pkt packet);
+pkt make_pkt(int seqnum, int acknum, struct msg message);
 
 /**
  * Send a packet.
@@ -115,4 +143,81 @@ void unacked(struct pkt packet);
  */
 bool sort_by_seq(const pkt &a, const pkt &b);
 
-#endif
\ No newline at end of file
+/**
+ * Forward error correction (see fec.h), when the emulator turns it on:
+ * the sender follows every block of first transmissions with parity, and
+ * the receiver keeps the blocks it is receiving so that packets rebuilt
+ * from parity, and the ones that arrived after them, are delivered
+ * without going back N.
+ */
+extern struct fec_encoder fec_tx;
+extern struct fec_decoder fec_rx;
+
+/**
+ * Send a packet for the first time, followed by its block's parity
+ * packets if it completes one.
+ *
+ * @param packet the packet to send
+ */
+void send_new(struct pkt packet);
+
+/**
+ * B_input with FEC on: pass an intact packet through the decoder and
+ * deliver every packet it now holds in order.
+ *
+ * @param packet the packet from the network
+ */
+void B_fec_input(struct pkt packet);
+
+/**
+ * Pacing, when the emulator turns it on (-g b). Without it A hands every
+ * packet the window allows to the network at once, and a timeout resends
+ * the whole window in one burst. With it every packet A sends, new or
+ * resent, waits in paced_buf for its slot: packets go one round trip's
+ * worth of window apart, srtt / usable_window(), and at most pace_burst
+ * of them back to back. The slots are a token bucket kept as a single
+ * time (the generic cell rate algorithm): pace_next is when the next
+ * packet would go at exactly the rate, and one may go up to pace_burst - 1
+ * gaps early.
+ *
+ * srtt is a moving average of the time from sending a packet to its ACK,
+ * timing one first transmission at a time (rtt_seq, sent at rtt_sent) and
+ * none that were resent. A has one timer, so it goes off at whichever is
+ * sooner: the next slot, or the timeout at rto_at. No packet times out
+ * until it has been out for timer_interval, however long it waited here.
+ */
+extern int pace_burst;
+extern std::deque<struct pkt> paced_buf;
+extern float pace_next;
+extern float rto_at;
+extern float srtt;
+extern int rtt_seq;
+extern float rtt_sent;
+extern int rtt_next;
+
+/**
+ * Hand a packet A sends to the network, or to the pacer when it is on.
+ *
+ * @param packet the packet to send
+ */
+void transmit(struct pkt packet);
+
+/**
+ * Send every packet in paced_buf whose slot has come.
+ */
+void pace();
+
+/**
+ * Start A's timer for the next slot or the timeout, whichever is sooner.
+ */
+void pace_timer();
+
+/**
+ * A_timerinterrupt with pacing on: send the packets whose slots have
+ * come, after queueing the whole window again if it timed out.
+ */
+void A_paced_timerinterrupt();
+
+} // namespace gbn
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef METRICS_H_
+#define METRICS_H_
+
+#include <stdint.h>
+
+/**
+ * Live metrics of a running simulation.
+ *
+ * With -M path the emulator maps a one-page file shared and republishes
+ * a snapshot of its progress there every METRICS_PERIOD seconds of wall
+ * time. Other processes (the monitor tool) map the same file read-only,
+ * so watching a run costs it nothing but the copy.
+ *
+ * The page is guarded by a sequence lock: the writer makes seq odd while
+ * it updates the page and even again after, and a reader retries until
+ * it sees the same even value before and after its copy.
+ */
+#define METRICS_MAGIC 0x4d544452 // "RDTM"
+#define METRICS_VERSION 1
+#define METRICS_PERIOD 0.5       // Seconds of wall time between snapshots
+
+struct metrics_page {
+  uint32_t magic;
+  uint32_t version;
+  volatile uint32_t seq;  // Odd while the page is being written
+  int32_t pid;            // The emulator's process
+  char protocol[8];
+  int32_t done;           // Set by the last snapshot of the run
+  int32_t blocked;        // The application is blocked on A
+  double sim_time;
+  double wall_time;       // Seconds since the run started
+  int32_t nsim;           // Messages handed to A so far
+  int32_t nsimmax;
+  int32_t evlist;         // Events waiting in the event list
+  int32_t evlist_max;
+  uint64_t events;        // Events simulated
+  double events_per_sec;  // Over the last period of wall time
+  int32_t A_application;
+  int32_t A_transport;
+  int32_t B_transport;
+  int32_t B_application;
+  int32_t retransmissions;
+  int32_t inflight;       // Packets in the medium
+  double throughput;      // Deliveries at B per time unit, whole run
+  double recent_throughput; // The same over the last period
+};
+
+/**
+ * Create (or truncate) a metrics file and map it for writing.
+ *
+ * @return the page, or NULL with errno set
+ */
+struct metrics_page *metrics_create(const char *path);
+
+/**
+ * Map an existing metrics file for reading.
+ *
+ * @return the page, or NULL with errno set (EINVAL if it is not one)
+ */
+const struct metrics_page *metrics_attach(const char *path);
+
+/**
+ * Publish a snapshot: copy everything but the header from m into page.
+ */
+void metrics_publish(struct metrics_page *page,
+                     const struct metrics_page *m);
+
+/**
+ * Take a consistent copy of the page.
+ */
+void metrics_read(const struct metrics_page *page, struct metrics_page *out);
+
+/**
+ * Unmap a page.
+ */
+void metrics_close(const struct metrics_page *page);
+
+#endif
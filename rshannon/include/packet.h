@@ -6,29 +6,21 @@
 #define MSG_LEN 20     // The number of bytes in each packet payload or message
 
 /**
- * Take a packet structure and calculate
- * its checksum by adding up each 16 bit word
- * and flipping the result.
+ * Every protocol provides the same packet helpers in its own namespace
+ * (declared in abt.h, gbn.h and sr.h):
  *
- * Note that overflow bits are wrapped around
- * and added again.
+ * int checksum(struct pkt packet)
+ *   Take a packet structure and calculate its checksum by adding up each
+ *   8 bit chunk of data, ignoring the checksum field.
  *
- * @param  packet the packet structure
- * @return        an integer checksum
- */
-int checksum(struct pkt packet);
-bool is_corrupt(struct pkt packet);
-
-/**
- * Construct a packet.
+ * bool is_corrupt(struct pkt packet)
+ *   Whether the packet's checksum field disagrees with its contents.
  *
- * @param  seqnum the sequence number of the packet
- * @param  acknum the ack number of the packet
- * @param  data   the packet payload
- * @return        a packet with calculated checksum
+ * pkt make_pkt(int seqnum, int acknum, struct msg message)
+ *   Construct a packet with calculated checksum.
+ *
+ * void send_pkt(int caller, struct pkt packet)
+ *   Hand a packet to layer 3 and do the protocol's timer bookkeeping.
  */
-pkt make_pkt(int seqnum, int acknum, char data[]);
-void send_pkt(int caller, struct pkt packet);
-
 
-#endif
\ No newline at end of file
+#endif
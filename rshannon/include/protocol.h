@@ -0,0 +1,129 @@
+#ifndef PROTOCOL_H_
+#define PROTOCOL_H_
+
+#include <stdio.h>
+
+#include "../include/simulator.h"
+
+/**
+ * Protocol registry.
+ *
+ * Each protocol implements the framework interface (A_output, A_input,
+ * A_timerinterrupt, A_init, B_input, B_init) in a namespace of its own, so
+ * every protocol can be linked into the same binary and picked at run
+ * time with -P.
+ *
+ * A protocol is used in one of two ways:
+ *
+ * - Statically. <name>_protocol is a type whose static members call
+ *   straight into the protocol. A runtime's event loop is a template over
+ *   that type, instantiated once per protocol, so the hot path has no
+ *   indirection at all. PROTOCOL_TABLE builds the table of instances to
+ *   pick from.
+ * - Dynamically. find_protocol() returns a struct protocol of function
+ *   pointers, for code where one indirect call per packet does not
+ *   matter.
+ *
+ * A_output returns whether the protocol took the message. When the
+ * emulator gives A a send buffer (getbufsize() > 0) a protocol holding
+ * that many messages refuses the next one rather than dropping it, and
+ * the emulator blocks the application until A has room again. With no
+ * limit a protocol may still turn a message away (ABT while a packet is
+ * outstanding); the message is then lost, as in the original emulator.
+ *
+ * Besides the framework interface each protocol provides:
+ *
+ * - backlog(), the messages A is holding, queued or sent but not yet
+ *   acknowledged, for the emulator's buffer occupancy statistics;
+ * - save_state(f) and load_state(f) to write and read back everything the
+ *   protocol keeps between calls, for the emulator's checkpoints (see
+ *   checkpoint.h);
+ * - reconfigure(), called when the emulator's parameters change in the
+ *   middle of a run, to pick up a new getwinsize().
+ *
+ * To add a protocol, implement the interface in namespace <name> and add
+ * X(<name>, arg) to PROTOCOLS.
+ */
+#define PROTOCOLS(X, arg) X(abt, arg) X(gbn, arg) X(sr, arg)
+
+/* "abt|gbn|sr", for usage messages */
+#define PROTOCOL_STR(ns, arg) "|" #ns
+#define PROTOCOL_NAMES (PROTOCOLS(PROTOCOL_STR, ) + 1)
+
+/* The framework interface of each protocol */
+#define PROTOCOL_DECLARE(ns, arg)                                             \
+  namespace ns {                                                              \
+  bool A_output(struct msg message);                                          \
+  void A_input(struct pkt packet);                                            \
+  void A_timerinterrupt();                                                    \
+  void A_init();                                                              \
+  void B_input(struct pkt packet);                                            \
+  void B_init();                                                              \
+  int backlog();                                                              \
+  void save_state(FILE *f);                                                   \
+  bool load_state(FILE *f);                                                   \
+  void reconfigure();                                                         \
+  }
+PROTOCOLS(PROTOCOL_DECLARE, )
+
+/* Static handles: abt_protocol, gbn_protocol, sr_protocol */
+#define PROTOCOL_TYPE(ns, arg)                                                \
+  struct ns##_protocol {                                                      \
+    static const char *name() { return #ns; }                                 \
+    static bool A_output(struct msg m) { return ns::A_output(m); }            \
+    static void A_input(struct pkt packet) { ns::A_input(packet); }           \
+    static void A_timerinterrupt() { ns::A_timerinterrupt(); }                \
+    static void A_init() { ns::A_init(); }                                    \
+    static void B_input(struct pkt packet) { ns::B_input(packet); }           \
+    static void B_init() { ns::B_init(); }                                    \
+    static int backlog() { return ns::backlog(); }                            \
+    static void save_state(FILE *f) { ns::save_state(f); }                    \
+    static bool load_state(FILE *f) { return ns::load_state(f); }             \
+    static void reconfigure() { ns::reconfigure(); }                          \
+  };
+PROTOCOLS(PROTOCOL_TYPE, )
+
+/**
+ * Initialiser for a table of a template instantiated for every protocol,
+ * to pick one by name. fn is a template over the protocol type:
+ *
+ *   template <class P> void simulate();
+ *   static const struct { const char *name; void (*run)(); } runs[] = {
+ *       PROTOCOL_TABLE(simulate)};
+ */
+#define PROTOCOL_ENTRY(ns, fn) {#ns, fn<ns##_protocol>},
+#define PROTOCOL_TABLE(fn) PROTOCOLS(PROTOCOL_ENTRY, fn)
+
+/**
+ * Dynamic handle.
+ */
+struct protocol {
+  const char *name;
+  bool (*A_output)(struct msg message);
+  void (*A_input)(struct pkt packet);
+  void (*A_timerinterrupt)();
+  void (*A_init)();
+  void (*B_input)(struct pkt packet);
+  void (*B_init)();
+  int (*backlog)();
+  void (*save_state)(FILE *f);
+  bool (*load_state)(FILE *f);
+  void (*reconfigure)();
+};
+
+/**
+ * Look up a protocol by name.
+ *
+ * @return the protocol, or NULL if there is none by that name
+ */
+const struct protocol *find_protocol(const char *name);
+
+/**
+ * The protocol a program is named after, such as gbn for ./gbn or
+ * ./gbn_udp, so the per-protocol binaries keep working without -P.
+ *
+ * @return the protocol, or NULL if the name is not a protocol's
+ */
+const struct protocol *default_protocol(const char *program);
+
+#endif
@@ -0,0 +1,121 @@
+#ifndef REALTIME_H_
+#define REALTIME_H_
+
+#include "../include/simulator.h"
+#include "../include/protocol.h"
+#include <stdint.h>
+
+/**
+ * Shared pieces of the real-time runtimes. These implement the simulator
+ * API on top of a real transport and a real monotonic clock instead of the
+ * discrete-event emulator, so the protocol sources run unchanged.
+ *
+ * Simulated time units are mapped onto wall-clock time through a fixed
+ * scale (-u), so protocol constants such as timer intervals keep their
+ * meaning relative to the message inter-arrival time (-t).
+ */
+
+/**
+ * Run configuration, parsed from the same flags as the emulator.
+ */
+struct rt_config {
+  int seed;          // -s random seed for impairment and arrivals
+  int win_size;      // -w window size returned by getwinsize()
+  int nsimmax;       // -m number of messages to hand to A
+  float lossprob;    // -l probability that a packet is dropped
+  float corruptprob; // -c probability that a packet is corrupted
+  float lambda;      // -t mean time units between messages from layer 5
+  int trace;         // -v tracing level
+  float time_unit;   // -u microseconds of wall time per time unit
+  float grace;       // -g time units to keep running after the last message
+  const struct protocol *proto; // -P protocol, by default the one the
+                                // program is named after
+};
+
+extern struct rt_config rtcfg;
+
+/**
+ * Statistics, reported in the same [PA2] form as the emulator.
+ */
+extern int A_application;
+extern int A_transport;
+extern int B_application;
+extern int B_transport;
+
+/**
+ * Parse the command line into rtcfg. Exits on invalid input.
+ *
+ * @param argc     argument count
+ * @param argv     argument vector
+ * @param extra    getopt spec of additional backend flags, or ""
+ * @param handler  called for each additional flag, may be NULL
+ */
+void rt_parse_args(int argc, char **argv, const char *extra,
+                   void (*handler)(int opt, char *arg));
+
+/**
+ * Nanoseconds on the monotonic clock.
+ */
+uint64_t rt_now_ns();
+
+/**
+ * Mark the start of the run; get_sim_time() counts from here.
+ */
+void rt_start();
+
+/**
+ * Convert between time units and nanoseconds using rtcfg.time_unit.
+ */
+uint64_t rt_units_to_ns(float units);
+float rt_ns_to_units(uint64_t ns);
+
+/**
+ * Return a float uniform in [0,1] from a caller-owned random state.
+ */
+float rt_rand(unsigned int *state);
+
+/**
+ * Apply the emulator's loss and corruption model to an outbound packet.
+ *
+ * @param  packet the packet, corrupted in place when selected
+ * @param  state  the caller's random state
+ * @return        false if the packet is lost
+ */
+bool rt_impair(struct pkt *packet, unsigned int *state);
+
+/**
+ * Draw the gap to the next layer 5 arrival, uniform on [0,2*lambda].
+ */
+float rt_next_gap(unsigned int *state);
+
+/**
+ * Fill in the n-th message handed to A, as the emulator does.
+ */
+void rt_make_msg(int n, struct msg *message);
+
+/**
+ * Account a packet's one-way transport latency.
+ */
+void rt_record_latency(uint64_t ns);
+
+/**
+ * Latency accumulated by rt_record_latency(), for runtimes that measure in
+ * more than one process and fold the results together before reporting.
+ */
+struct rt_latency {
+  uint64_t count;
+  uint64_t sum;
+  uint64_t min;
+  uint64_t max;
+};
+void rt_latency_get(struct rt_latency *latency);
+void rt_latency_merge(const struct rt_latency *latency);
+
+/**
+ * Print the [PA2] block followed by wall-clock statistics.
+ *
+ * @param name the runtime name shown in the report
+ */
+void rt_report(const char *name);
+
+#endif
@@ -0,0 +1,174 @@
+#ifndef RESULTS_H_
+#define RESULTS_H_
+
+#include <stdint.h>
+#include <vector>
+
+/**
+ * Binary columnar results files.
+ *
+ * A results file is a sequence of self-describing row groups, so runs can
+ * append to the same file without reading it first. Each group is:
+ *
+ *   "RCOL" magic, u16 version, u16 column count, u32 row count
+ *   per column: u8 type, u8 name length, name bytes
+ *   per column: row count values, packed little-endian
+ *
+ * The writer buffers rows and emits a group per flush, taking an
+ * exclusive lock around the append so concurrent runs can share a file.
+ * The reader loads one group at a time and exposes each column as a
+ * contiguous array.
+ */
+
+#define RESULTS_MAGIC "RCOL"
+#define RESULTS_VERSION 1
+
+/* Column types */
+#define COL_I32 0   // int32_t
+#define COL_F64 1   // double
+#define COL_STR8 2  // char[8], NUL padded
+
+/**
+ * One simulator run: its configuration, the [PA2] counters, what B's
+ * deliveries turned out to be, the message delay quantiles, A's send
+ * buffer, FEC, flow control, the topology and how fast the emulator ran.
+ */
+struct result_row {
+  // Configuration
+  char protocol[8];
+  int32_t seed;
+  int32_t window;
+  int32_t messages;
+  double loss;
+  double corrupt;
+  double lambda;
+  // Counters
+  int32_t A_application;
+  int32_t A_transport;
+  int32_t B_transport;
+  int32_t B_application;
+  int32_t retransmissions;
+  double total_time;
+  double throughput;
+  // Deliveries at B, validated against what A was handed
+  double goodput;       // Messages delivered intact and in order, per time
+  int32_t duplicates;
+  int32_t out_of_order; // Messages delivered after later ones
+  int32_t unmatched;    // Deliveries matching no message: corrupted
+  int32_t skipped;      // Messages passed over by a later delivery
+  // Message delay, in time units
+  double delay_mean;
+  double delay_p50;
+  double delay_p99;
+  double delay_p999;
+  double delay_max;
+  // Send buffer at A
+  int32_t buffer_limit; // -q, 0 for none
+  int32_t buffer_max;
+  double buffer_mean;   // Time average of the messages A held
+  double blocked_time;  // Time the application spent blocked on A
+  int32_t refused;      // Messages refused by A and lost
+  // Forward error correction
+  int32_t fec_block;    // -f data packets per block, 0 for none
+  int32_t fec_parity;   // Parity packets per block
+  int32_t fec_parity_sent;
+  int32_t fec_recovered; // Data packets rebuilt at B
+  // Pacing
+  int32_t pacing;       // -g packets A may send back to back, 0 for none
+  int32_t burst_max;    // Most packets A sent at one instant
+  double burst_mean;    // Packets A sent per instant it sent any
+  // Flow control
+  double read_time;     // -C mean time B's application takes per message
+  int32_t unread_max;   // Most messages waiting unread at B
+  // Topology
+  int32_t hops;         // Links from A to B, 1 without -T
+  int32_t queue_drops;  // Packets dropped by full router queues
+  // Simulator speed
+  double events;        // Events simulated
+  double wall_time;     // Seconds of wall time the event loop took
+};
+
+/**
+ * Streaming writer.
+ */
+struct results_writer {
+  int fd;
+  std::vector<result_row> rows; // Buffered until the next flush
+};
+
+/**
+ * Open a results file for appending, creating it if needed.
+ *
+ * @return the writer, or NULL on error (errno is set)
+ */
+struct results_writer *results_open(const char *path);
+
+/**
+ * Buffer a row; a full buffer is flushed as its own row group.
+ */
+void results_append(struct results_writer *w, const struct result_row *row);
+
+/**
+ * Write buffered rows as one row group.
+ *
+ * @return false on I/O error
+ */
+bool results_flush(struct results_writer *w);
+
+/**
+ * Flush and close.
+ */
+bool results_close(struct results_writer *w);
+
+/**
+ * A column of the row group currently loaded by a reader.
+ */
+struct results_column {
+  int type;
+  char name[256];
+  std::vector<char> data; // nrows packed values
+};
+
+/**
+ * Row-group-at-a-time reader.
+ */
+struct results_reader {
+  int fd;
+  uint32_t nrows;                       // Rows in the current group
+  std::vector<results_column> columns; // Columns of the current group
+};
+
+/**
+ * Open a results file for reading.
+ *
+ * @return the reader, or NULL on error (errno is set)
+ */
+struct results_reader *results_read_open(const char *path);
+
+/**
+ * Load the next row group.
+ *
+ * @return 1 if a group was loaded, 0 at end of file, -1 if malformed
+ */
+int results_next_group(struct results_reader *r);
+
+/**
+ * Typed views of a column of the current group, by name.
+ *
+ * @return the column's values, or NULL if there is no such column of that
+ *         type
+ */
+const int32_t *results_i32(const struct results_reader *r, const char *name);
+const double *results_f64(const struct results_reader *r, const char *name);
+const char *results_str8(const struct results_reader *r, const char *name);
+
+/**
+ * Rebuild row i of the current group. Columns missing from the group are
+ * left zero.
+ */
+void results_row(const struct results_reader *r, uint32_t i,
+                 struct result_row *row);
+
+void results_read_close(struct results_reader *r);
+
+#endif
@@ -20,15 +20,9 @@ struct pkt {
    char payload[20];
 };
 
-/* Implementation framework interface */
-void A_output(struct msg message);
-void B_output(struct msg message);
-void A_input(struct pkt packet);
-void A_timerinterrupt();
-void A_init();
-
-void B_input(struct pkt packet);
-void B_init();
+/* Implementation framework interface: each protocol implements A_output, */
+/* A_input, A_timerinterrupt, A_init, B_input and B_init in its own        */
+/* namespace, see protocol.h                                                */
 
 /* Simulator API */
 void starttimer(int AorB, float increment);
@@ -36,6 +30,14 @@ void stoptimer(int AorB);
 void tolayer3(int AorB, struct pkt packet);
 void tolayer5(int AorB, char datasent[]);
 int getwinsize();
+int getbufsize();          /* messages A may hold before A_output refuses */
+                           /* one, 0 for no limit (see protocol.h)        */
+int getfecblock();         /* data packets per FEC block, 0 for no FEC    */
+int getfecparity();        /* parity packets per FEC block (see fec.h)    */
+int getpacing();           /* packets A may send back to back when it     */
+                           /* paces them, 0 for no pacing (see gbn.h)     */
+int getunread();           /* messages delivered to B's layer 5 that its  */
+                           /* application has not read yet                */
 float get_sim_time();
 
 #endif
\ No newline at end of file
@@ -0,0 +1,79 @@
+#ifndef SPSC_RING_H_
+#define SPSC_RING_H_
+
+#include <atomic>
+#include <stdint.h>
+
+/**
+ * Lock-free single-producer/single-consumer ring buffer.
+ *
+ * The ring holds its slots inline and uses only lock-free 32-bit atomics,
+ * so it can be placed in memory shared between processes as well as
+ * between threads. Capacity must be a power of two. The producer owns
+ * tail and the consumer owns head; each side caches the other's index so
+ * the shared cache line is only touched when the cached view runs out.
+ */
+template <typename T, uint32_t N> struct spsc_ring {
+  static_assert((N & (N - 1)) == 0, "capacity must be a power of two");
+
+  alignas(64) std::atomic<uint32_t> head; // Next slot to consume
+  alignas(64) std::atomic<uint32_t> tail; // Next slot to produce
+  alignas(64) uint32_t cached_head;       // Producer's view of head
+  alignas(64) uint32_t cached_tail;       // Consumer's view of tail
+  T slots[N];
+
+  /**
+   * Reset to empty. Must not race with push() or pop().
+   */
+  void init() {
+    head.store(0, std::memory_order_relaxed);
+    tail.store(0, std::memory_order_relaxed);
+    cached_head = 0;
+    cached_tail = 0;
+  }
+
+  /**
+   * Producer side: append an item.
+   *
+   * @param  item the item to copy in
+   * @return      false if the ring is full
+   */
+  bool push(const T &item) {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    if (t - cached_head == N) {
+      cached_head = head.load(std::memory_order_acquire);
+      if (t - cached_head == N) {
+        return false;
+      }
+    }
+    slots[t & (N - 1)] = item;
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Consumer side: look at the oldest item without removing it.
+   *
+   * @return the oldest item, or NULL if the ring is empty
+   */
+  T *front() {
+    uint32_t h = head.load(std::memory_order_relaxed);
+    if (h == cached_tail) {
+      cached_tail = tail.load(std::memory_order_acquire);
+      if (h == cached_tail) {
+        return NULL;
+      }
+    }
+    return &slots[h & (N - 1)];
+  }
+
+  /**
+   * Consumer side: remove the item returned by front().
+   */
+  void pop() {
+    head.store(head.load(std::memory_order_relaxed) + 1,
+               std::memory_order_release);
+  }
+};
+
+#endif
@@ -2,8 +2,15 @@
 #define SR_H_
 
 #include "../include/simulator.h"
+#include "../include/fec.h"
 #include <queue>
 
+/**
+ * Selective Repeat (SR) protocol. Everything lives in namespace sr so
+ * it can be linked alongside the other protocols; see protocol.h.
+ */
+namespace sr {
+
 /**
  * The maximum number of active packet timers.
  */
@@ -27,7 +34,7 @@ struct pkt_timer {
 /**
  * Container for all packet timers.
  */
-std::vector<pkt_timer> pkt_timers;
+extern std::vector<pkt_timer> pkt_timers;
 
 /**
  * Helper methods to manage multiple packet timers
@@ -49,19 +56,19 @@ void fire_expired_pkt_timers();
 /**
  * Buffer containing all unacknowledged packets.
  */
-std::deque<struct pkt> unacked_buf;
+extern std::deque<struct pkt> unacked_buf;
 
 /**
  * Buffer containing all packets ready to be sent out
  * as soon as they are within the send window.
  */
-std::deque<struct pkt> unsent_buf;
+extern std::deque<struct pkt> unsent_buf;
 
 /**
  * Fire timer every X time units. This is a function
  * of the window size -- timer_interval = 5 * window_size
  */
-float timer_interval;
+extern float timer_interval;
 
 /**
  * Helper methods to add a packet to a buffer.
@@ -74,15 +81,35 @@ bool sort_by_seq(const pkt &a, const pkt &b);
 /**
  * Buffer which stores out of order packets on receiver side.
  */
-std::vector<pkt> recv_buf;
+extern std::vector<pkt> recv_buf;
 
 /**
  * Selective-Repeat protocol book-keeping variables.
  */
-int send_base;
-int next_seq_num;
-int window_size;
-int recv_base;
+extern int send_base;
+extern int next_seq_num;
+extern int window_size;
+extern int recv_base;
+
+/**
+ * Receiver-advertised window. B's receive buffer holds window_size
+ * messages, counting those delivered to its application but not yet read
+ * (see getunread()), and every ACK carries the room left in it as an int
+ * at the start of its payload. A keeps the latest value in rwnd and never
+ * has more than min(window_size, rwnd) packets outstanding; B drops data
+ * it has no room for. While the window is closed with nothing in flight,
+ * A's timer sends the next waiting packet as a probe.
+ */
+extern int rwnd;
+int usable_window();
+int receive_room();
+
+/**
+ * Packet helpers, as described in packet.h.
+ */
+int checksum(struct pkt packet);
+bool is_corrupt(struct pkt packet);
+pkt make_pkt(int seqnum, int acknum, struct msg message);
 
 /**
  * Send a packet through the network.
@@ -99,4 +126,31 @@ void send_pkt(int caller, struct pkt packet);
  */
 void resend_pkt(int seq_num);
 
-#endif
\ No newline at end of file
+/**
+ * Forward error correction (see fec.h), when the emulator turns it on:
+ * the sender follows every block of first transmissions with parity, and
+ * the receiver handles packets rebuilt from parity as if they had
+ * arrived.
+ */
+extern struct fec_encoder fec_tx;
+extern struct fec_decoder fec_rx;
+
+/**
+ * Send a packet for the first time, followed by its block's parity
+ * packets if it completes one.
+ *
+ * @param packet the packet to send
+ */
+void send_new_pkt(struct pkt packet);
+
+/**
+ * Receiver side handling of an intact data packet, whether it came from
+ * the network or was rebuilt from parity.
+ *
+ * @param packet the data packet
+ */
+void B_receive(struct pkt packet);
+
+} // namespace sr
+
+#endif
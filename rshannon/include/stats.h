@@ -0,0 +1,103 @@
+#ifndef STATS_H_
+#define STATS_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+/**
+ * Log-bucketed (HDR-style) histogram.
+ *
+ * Values are recorded with a fixed resolution of 1/HIST_SCALE. Below
+ * HIST_SUB units every value has its own bucket; above that each power of
+ * two is split into HIST_SUB/2 linear sub-buckets, so any recorded value is
+ * reported to within 1/(HIST_SUB/2) of its true value while the whole
+ * 64-bit range fits in a few thousand counters.
+ */
+#define HIST_SCALE 1000.0  // Resolution: 0.001 time units
+#define HIST_SUB_BITS 7
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS (HIST_SUB + (64 - HIST_SUB_BITS) * (HIST_SUB / 2))
+
+struct histogram {
+  uint64_t counts[HIST_BUCKETS];
+  uint64_t total; // Number of recorded values
+  double sum;     // Sum of recorded values, for the mean
+  double max;     // Largest recorded value
+};
+
+/**
+ * Record a non-negative value.
+ */
+void hist_record(struct histogram *h, double value);
+
+/**
+ * Value at quantile q (0.0 to 1.0), or 0 if nothing was recorded.
+ */
+double hist_quantile(const struct histogram *h, double q);
+
+/**
+ * Per-message tracking between A's application and B's application.
+ *
+ * Every message handed to A is remembered with its send time and a hash
+ * of its payload. Packets A hands to layer 3 and data B hands to layer 5
+ * are matched back to the message by payload, so the emulator can tell
+ * first transmissions from retransmissions and measure end-to-end delay
+ * without any help from the protocol code. Matching relies on payloads
+ * being distinct while a message is outstanding, which the emulator
+ * ensures by stamping each message's number into its payload.
+ *
+ * The same matching validates what B delivers. A message B delivers
+ * after every earlier one, with its payload intact, counts towards
+ * goodput. A delivery can also skip messages still outstanding, come
+ * late (a message skipped before), repeat a message already delivered,
+ * or match no message at all (a corrupted payload). Delivered and
+ * skipped messages are remembered for TRACK_HISTORY messages, so later
+ * copies of them can be told apart from corruption.
+ */
+#define TRACK_HISTORY 65536
+
+/* What a delivery at B turned out to be */
+#define DELIVERY_INORDER 0   // The next message, intact
+#define DELIVERY_GAP 1       // Intact, after skipping outstanding messages
+#define DELIVERY_LATE 2      // A message skipped before
+#define DELIVERY_DUPLICATE 3 // A message delivered before
+#define DELIVERY_UNMATCHED 4 // No message A was handed: corrupted
+
+/**
+ * A message with the given number was handed to A at time.
+ */
+void track_msg_sent(int id, float time, const char *data);
+
+/**
+ * A refused the message with the given number, which was lost (see -q).
+ * B is not expected to deliver it.
+ */
+void track_msg_refused(int id);
+
+/**
+ * A handed a packet carrying payload to layer 3.
+ *
+ * @return true if the message was transmitted before
+ */
+bool track_pkt_sent(const char *payload);
+
+/**
+ * B handed data to layer 5.
+ *
+ * @param  sent    set to the time the message was handed to A, for
+ *                 DELIVERY_INORDER and DELIVERY_GAP
+ * @param  skipped set to the outstanding messages a DELIVERY_GAP skipped
+ * @return         what the delivery was, a DELIVERY_ constant
+ */
+int track_msg_delivered(const char *data, float *sent, int *skipped);
+
+/**
+ * Write the tracker's outstanding messages to a checkpoint, or read them
+ * back (see checkpoint.h).
+ *
+ * @return false if the checkpoint is truncated
+ */
+void track_save(FILE *f);
+bool track_load(FILE *f);
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef TOPOLOGY_H_
+#define TOPOLOGY_H_
+
+#include <deque>
+#include <string>
+#include <vector>
+
+/**
+ * Multi-hop topologies for the emulated medium.
+ *
+ * By default a packet crosses a single implicit hop between A and B. With
+ * -T the medium is a graph read from a file instead, whose nodes are the
+ * hosts A and B and any number of store-and-forward routers. Each link
+ * has its own delay, loss, corruption, transmission time and output
+ * queue, separately in each direction, and packets are forwarded hop by
+ * hop along the route with the fewest hops (among routes of the same
+ * length, the one through the links listed first).
+ *
+ * A topology file has one link per line, '#' starting a comment:
+ *
+ *   link A r1 delay=1 jitter=9 loss=0.1 corrupt=0.05 service=0.5 queue=8
+ *
+ *   delay    least time a packet takes to cross it (default 1)
+ *   jitter   extra time, uniform on [0, jitter] (default 0). A link is
+ *            FIFO: a packet is due that long after the one before it
+ *            if that one is due later than it leaves
+ *   loss     probability that it loses a packet (default 0)
+ *   corrupt  probability that it corrupts one (default 0)
+ *   service  time it takes to send a packet (default 0). Packets handed
+ *            to it faster wait in its queue
+ *   queue    packets that may wait behind the one being sent, the rest
+ *            being dropped (default 0, no limit)
+ *
+ * Nodes other than A and B are routers, named by any other word. A
+ * single "link A B delay=1 jitter=9 loss=l corrupt=c" is the default
+ * medium of -l l -c c.
+ */
+#define TOPO_A 0 // Node numbers of the hosts, as their entity numbers
+#define TOPO_B 1
+
+/**
+ * One direction of a link, with the state of its queue and what it did.
+ */
+struct topo_link {
+  int from;
+  int to;
+  float delay;
+  float jitter;
+  float loss;
+  float corrupt;
+  float service;
+  int queue;                     // 0 for no limit
+  // State
+  float lastarrival;             // When its latest packet is due at to
+  std::deque<float> departures;  // When the packets it holds are sent
+  // Statistics
+  int offered;                   // Packets handed to it
+  int lost;
+  int corrupted;
+  int dropped;                   // Turned away by a full queue
+  int maxqueue;                  // Most packets waiting at once
+  double queuesum;               // Packets found waiting, over offered
+};
+
+struct topology {
+  std::vector<std::string> nodes; // By number, A and B first
+  std::vector<topo_link> links;   // Both directions of each link
+  std::vector<int> route[2];      // [host][node]: link toward host, or -1
+};
+
+/**
+ * Read a topology file, reporting any error in it on stderr.
+ *
+ * @return false if it could not be read, or A and B are not connected
+ */
+bool topo_load(struct topology *t, const char *path);
+
+/**
+ * The link a packet at node takes toward host (TOPO_A or TOPO_B).
+ */
+struct topo_link *topo_next(struct topology *t, int node, int host);
+
+/**
+ * Links a packet crosses from host to the other.
+ */
+int topo_hops(const struct topology *t, int host);
+
+/**
+ * Hand a packet to a link at time now.
+ *
+ * @param  depart set to when the link is done sending it
+ * @return        false if the link's queue is full and drops it
+ */
+bool topo_enqueue(struct topo_link *link, float now, float *depart);
+
+/**
+ * Packets dropped by full queues, over every link.
+ */
+int topo_dropped(const struct topology *t);
+
+/**
+ * Print what each link on the routes between A and B did, hop by hop.
+ */
+void topo_report(const struct topology *t);
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef WORKLOAD_H_
+#define WORKLOAD_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "packet.h"
+
+/**
+ * Recorded application workloads.
+ *
+ * A workload file holds the messages an application handed to its
+ * transport, in order, each with the time it was handed over and its
+ * payload. With -A the emulator replays one in place of its synthetic
+ * arrivals: message n arrives the recorded gap after message n - 1,
+ * scaled by -t (1 keeps the recorded timing), and carries record n's
+ * payload. The file is mapped read-only and read in place, so a replay
+ * streams through it with no reads or copies beyond the batch of gaps
+ * drawn ahead.
+ *
+ * The capture tool converts a text capture, one "time payload" line per
+ * message, into a workload file and back.
+ */
+#define WORKLOAD_MAGIC 0x57544452 // "RDTW"
+#define WORKLOAD_VERSION 1
+
+struct workload_header {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t count;     // Records that follow
+};
+
+struct workload_record {
+  double time;        // Since the start of the capture, never decreasing
+  char data[MSG_LEN]; // The first MSG_LEN bytes of the message
+  uint32_t reserved;  // Zero
+};
+
+/**
+ * A mapped workload file.
+ */
+struct workload {
+  const struct workload_record *records;
+  uint64_t count;
+  void *map;
+  size_t size;
+};
+
+/**
+ * Map a workload file for reading.
+ *
+ * @return false with errno set (EINVAL if it is not one)
+ */
+bool workload_open(struct workload *w, const char *path);
+
+/**
+ * Unmap a workload file.
+ */
+void workload_close(struct workload *w);
+
+/**
+ * Create (or truncate) a workload file holding count records.
+ *
+ * @return false with errno set
+ */
+bool workload_save(const char *path, const struct workload_record *records,
+                   uint64_t count);
+
+#endif
@@ -1,6 +1,8 @@
 #include "../include/packet.h"
 #include "../include/abt.h"
 #include "../include/simulator.h"
+#include "../include/protocol.h"
+#include "../include/checkpoint.h"
 #include <cstring>
 #include <iostream>
 
@@ -14,6 +16,16 @@
 
 #define TIMER_INTERVAL 10.0 // Trigger timer interrupt every X time units
 
+namespace abt {
+
+/* Protocol state, documented in abt.h */
+bool is_acked;
+int current_seq_no;
+int last_recv_seq_no;
+std::queue<struct msg> msg_queue;
+struct pkt pkt_buf;
+int num_pkts_sent;
+
 /**
  * Alternate a single sequence or ack number between
  * 0 and 1.
@@ -142,13 +154,21 @@ int checksum(struct pkt packet) {
 /**
  * Called by application (layer 5) to send a message to client B.
  *
+ * While a packet is outstanding the message is queued if the emulator
+ * gave A a send buffer with room left, and refused otherwise.
+ *
  * @param message the message to send
+ * @return        false if the message was not taken
  */
-void A_output(struct msg message) {
+bool A_output(struct msg message) {
   if (!is_acked) {
+    if (getbufsize() > 0 && backlog() < getbufsize()) {
+      queue_msg(message);
+      return true;
+    }
     DEBUG("still waiting for an ACK but received message from receiver, "
-          "dropping message...");
-    return;
+          "refusing message...");
+    return false;
   }
   // Construct packet
   struct pkt packet = make_pkt(current_seq_no, 0, message);
@@ -159,8 +179,14 @@ void A_output(struct msg message) {
   send_pkt(0, packet);
   num_pkts_sent += 1;
   DEBUG("sender: sent " << num_pkts_sent << " packets thus far");
+  return true;
 }
 
+/**
+ * The messages A is holding: the queue and the packet awaiting its ACK.
+ */
+int backlog() { return msg_queue.size() + (is_acked ? 0 : 1); }
+
 /**
  * Called when packet arrives at client A from the network.
  *
@@ -240,3 +266,55 @@ void B_input(struct pkt packet) {
  * Receiver side initialization.
  */
 void B_init() { last_recv_seq_no = -1; }
+
+
+/**
+ * Write the protocol state to a checkpoint.
+ *
+ * @param f the checkpoint file
+ */
+void save_state(FILE *f) {
+  std::queue<struct msg> queued = msg_queue;
+  ckpt_put(f, is_acked);
+  ckpt_put(f, current_seq_no);
+  ckpt_put(f, last_recv_seq_no);
+  ckpt_put(f, pkt_buf);
+  ckpt_put(f, num_pkts_sent);
+  ckpt_put(f, (uint32_t)queued.size());
+  while (!queued.empty()) {
+    ckpt_put(f, queued.front());
+    queued.pop();
+  }
+}
+
+/**
+ * Read back the protocol state written by save_state.
+ *
+ * @param  f the checkpoint file
+ * @return   false if the checkpoint is truncated
+ */
+bool load_state(FILE *f) {
+  uint32_t n;
+  if (!ckpt_get(f, is_acked) || !ckpt_get(f, current_seq_no) ||
+      !ckpt_get(f, last_recv_seq_no) || !ckpt_get(f, pkt_buf) ||
+      !ckpt_get(f, num_pkts_sent) || !ckpt_get(f, n)) {
+    return false;
+  }
+  msg_queue = std::queue<struct msg>();
+  for (uint32_t i = 0; i < n; i++) {
+    struct msg message;
+    if (!ckpt_get(f, message)) {
+      return false;
+    }
+    msg_queue.push(message);
+  }
+  return true;
+}
+
+/**
+ * Called when the emulator's parameters change mid-run. The alternating
+ * bit protocol has no window, so there is nothing to pick up.
+ */
+void reconfigure() {}
+
+} // namespace abt
@@ -0,0 +1,260 @@
+#include <math.h>
+#include <string.h>
+
+#include "../include/analytic.h"
+
+/* The emulator's channel (see tolayer3 in simulator.cpp) */
+#define DELAY_MIN 1.0    // Fastest crossing
+#define DELAY_SPREAD 9.0 // Crossings take DELAY_MIN + DELAY_SPREAD * U
+#define DELAY_MEAN (DELAY_MIN + DELAY_SPREAD / 2)
+#define ROUND_TRIP_MAX (2 * (DELAY_MIN + DELAY_SPREAD))
+#define CHANNEL_CAPACITY (1.0 / DELAY_MEAN) // Packets per time unit
+
+#define STEPS 64        // Integration steps per timeout, even for Simpson
+#define TAIL 1e-12      // Survival below which the rest is dropped
+
+/**
+ * Each protocol's timeout: TIMER_INTERVAL in abt.cpp, timer_interval in
+ * gbn.cpp's A_init and PKT_TIMEOUT in sr.h.
+ */
+static const struct {
+  const char *name;
+  double timeout;
+} models[] = {{"abt", 10.0}, {"gbn", 11.0}, {"sr", 15.0}};
+#define NMODELS (sizeof(models) / sizeof(models[0]))
+
+/**
+ * Moments of the service time S.
+ */
+struct attempts {
+  double service;  // E[S]
+  double sent;     // E[copies sent]
+  double renewals; // E[m(S)], arrivals after the first that fall within S
+};
+
+/**
+ * Distribution function of a round trip, the sum of two crossings.
+ */
+static double round_trip_cdf(double t) {
+  double x = t - 2 * DELAY_MIN, w = DELAY_SPREAD;
+  if (x <= 0) {
+    return 0.0;
+  }
+  if (x >= 2 * w) {
+    return 1.0;
+  }
+  if (x <= w) {
+    return x * x / (2 * w * w);
+  }
+  return 1.0 - (2 * w - x) * (2 * w - x) / (2 * w * w);
+}
+
+/**
+ * P(S > t): copy i is sent at i * timeout and gets its ACK back within
+ * the round trip with probability q.
+ */
+static double survival(double t, double q, double timeout) {
+  double g = 1.0;
+  for (int i = 0; i * timeout < t; i++) {
+    g *= 1.0 - q * round_trip_cdf(t - i * timeout);
+  }
+  return g;
+}
+
+/**
+ * Derivative of the renewal function of arrival gaps uniform on
+ * [0, 2 * lambda]. With u = t / (2 * lambda) the renewal function is
+ * e^u - 1 up to u = 1 and e^u - 1 - (u - 1) e^(u - 1) up to u = 2; past
+ * that it is within 0.2% of its asymptote 2u - 1/3.
+ */
+static double renewal_density(double t, double lambda) {
+  double u = t / (2 * lambda);
+  if (u <= 1.0) {
+    return exp(u) / (2 * lambda);
+  }
+  if (u <= 2.0) {
+    return (exp(u) - u * exp(u - 1)) / (2 * lambda);
+  }
+  return 1.0 / lambda;
+}
+
+/**
+ * Integrate the service time distribution one timeout at a time.
+ *
+ * Once a timeout period starts past the longest round trip, every copy
+ * but the newest has either been ACKed or lost for good, so each period's
+ * survival is the previous one's times (1 - q) and the rest of the series
+ * is geometric.
+ */
+static struct attempts service_time(double q, double timeout, double lambda) {
+  struct attempts a = {0.0, 0.0, 0.0};
+  double g[STEPS + 1], h = timeout / STEPS;
+
+  for (int k = 0;; k++) {
+    double start = k * timeout, period = 0.0, weighted = 0.0;
+    for (int j = 0; j <= STEPS; j++) {
+      double t = start + j * h;
+      if (start < ROUND_TRIP_MAX) {
+        g[j] = survival(t, q, timeout);
+      } else {
+        g[j] *= 1.0 - q;
+      }
+      double w = (j == 0 || j == STEPS) ? 1.0 : (j % 2 ? 4.0 : 2.0);
+      period += w * g[j];
+      weighted += w * g[j] * renewal_density(t, lambda);
+    }
+    period *= h / 3;
+    weighted *= h / 3;
+    a.service += period;
+    a.renewals += weighted;
+    a.sent += g[0]; // Copy k goes out unless S <= start
+
+    if (g[0] < TAIL) {
+      break;
+    }
+    if (start >= ROUND_TRIP_MAX && start >= 4 * lambda) {
+      double rest = (1.0 - q) / q;
+      a.service += period * rest;
+      a.renewals += period * rest / lambda;
+      a.sent += g[0] * rest;
+      break;
+    }
+  }
+  return a;
+}
+
+double analytic_timeout(const char *protocol) {
+  for (size_t i = 0; i < NMODELS; i++) {
+    if (strcmp(models[i].name, protocol) == 0) {
+      return models[i].timeout;
+    }
+  }
+  return 0.0;
+}
+
+/**
+ * Stop-and-wait: a message is accepted only when nothing is outstanding,
+ * so each delivered message takes a service time plus the wait for the
+ * first arrival after it. That arrival is the first renewal past S,
+ * lambda * (1 + m(S)) after the accepted one by Wald's identity.
+ */
+static void stop_and_wait(const struct analytic_params *p, double q,
+                          double timeout, struct analytic_estimate *e) {
+  struct attempts a = service_time(q, timeout, p->lambda);
+  e->service_time = a.service;
+  e->transmissions = a.sent;
+  e->capacity = 1.0 / a.service;
+  e->throughput = 1.0 / (p->lambda * (1.0 + a.renewals));
+  e->bound = "stop-and-wait";
+}
+
+/**
+ * Messages still in flight when the run stops at the last arrival are
+ * never delivered, which takes a latency's worth off the offered load.
+ */
+static double offered_load(const struct analytic_params *p, double latency) {
+  double span = p->messages * p->lambda;
+  return fmax(span - latency, 0.0) / span / p->lambda;
+}
+
+/**
+ * Selective repeat: every copy of a message is resent alone, so the
+ * offered load gets through unless the window (window / service time) or
+ * the channel (its capacity / copies per message) carries less.
+ */
+static void selective_repeat(const struct analytic_params *p, double q,
+                             double timeout, struct analytic_estimate *e) {
+  struct attempts a = service_time(q, timeout, p->lambda);
+  double window_capacity = p->window / a.service;
+  double channel_capacity = CHANNEL_CAPACITY / a.sent;
+
+  e->service_time = a.service;
+  e->transmissions = a.sent;
+  e->capacity = fmin(window_capacity, channel_capacity);
+  if (e->capacity >= 1.0 / p->lambda) {
+    e->throughput = offered_load(p, fmax(a.service - DELAY_MEAN, DELAY_MEAN));
+    e->bound = "offered load";
+  } else {
+    e->throughput = e->capacity;
+    e->bound = window_capacity < channel_capacity ? "window" : "channel";
+  }
+}
+
+/**
+ * Packets the go-back-N receiver takes in order from a round of k: those
+ * up to the first one that does not get through (p each).
+ */
+static double go_back_n_delivered(double p, int k) {
+  return p < 1.0 ? p * (1.0 - pow(p, k)) / (1.0 - p) : k;
+}
+
+/**
+ * Go-back-N rate with k packets outstanding. A round sends the k packets
+ * back to back, so they take k crossings to drain through the channel and
+ * one more for the last ACK; unless all of them get through the round
+ * ends with a timeout that sends them all again.
+ */
+static double go_back_n_rate(double p, int k, double timeout) {
+  double round = (k + 1) * DELAY_MEAN + (1.0 - pow(p, k)) * timeout;
+  return go_back_n_delivered(p, k) / round;
+}
+
+/**
+ * Go-back-N. As the backlog grows so does the number of packets
+ * outstanding, so the load gets through if some k up to the window
+ * carries it. A full window may carry less, in which case a burst that
+ * fills the window can tip the run into that slower state for good: the
+ * estimate then reports it as the collapse throughput.
+ */
+static void go_back_n(const struct analytic_params *p, double q,
+                      double timeout, struct analytic_estimate *e) {
+  struct attempts a = service_time(q, timeout, p->lambda);
+  double crossing = sqrt(q), offered = 1.0 / p->lambda;
+  double full = go_back_n_rate(crossing, p->window, timeout);
+  int k;
+  e->capacity = 0.0;
+  for (k = 1; k <= p->window; k++) {
+    e->capacity = fmax(e->capacity, go_back_n_rate(crossing, k, timeout));
+    if (e->capacity >= offered) {
+      break;
+    }
+  }
+
+  e->service_time = a.service;
+  if (e->capacity >= offered) {
+    e->throughput = offered_load(p, fmax(a.service - DELAY_MEAN, DELAY_MEAN));
+    e->bound = "offered load";
+    e->collapse = full < offered ? full : 0.0;
+  } else {
+    k = p->window;
+    e->throughput = full;
+    e->bound = "window";
+  }
+  e->transmissions = k / go_back_n_delivered(crossing, k);
+}
+
+bool analytic_run(const struct analytic_params *p,
+                  struct analytic_estimate *e) {
+  double timeout = p->timeout > 0.0 ? p->timeout : analytic_timeout(p->protocol);
+  if (timeout <= 0.0) {
+    return false;
+  }
+  // Both the packet and its ACK have to get through intact
+  double crossing = (1.0 - p->loss) * (1.0 - p->corrupt);
+  double q = crossing * crossing;
+  e->collapse = 0.0;
+  if (q <= 0.0) {
+    e->throughput = e->capacity = 0.0;
+    e->service_time = e->transmissions = INFINITY;
+    e->bound = "channel";
+    return true;
+  }
+  if (strcmp(p->protocol, "abt") == 0) {
+    stop_and_wait(p, q, timeout, e);
+  } else if (strcmp(p->protocol, "gbn") == 0) {
+    go_back_n(p, q, timeout, e);
+  } else {
+    selective_repeat(p, q, timeout, e);
+  }
+  return true;
+}
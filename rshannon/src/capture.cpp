@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <getopt.h>
+#include <vector>
+
+#include "../include/workload.h"
+
+/*
+ * Converts a text capture of an application's messages into a workload
+ * file the emulator can replay with -A (see workload.h), or with -d
+ * prints a workload file back as text:
+ *
+ *   capture traffic.txt traffic.wl
+ *   rdt -P sr -s 1 -w 50 -m 100000 -l 0.1 -c 0.1 -t 1 -v 0 -A traffic.wl
+ *   capture -d traffic.wl
+ *
+ * Each line of a capture is a message: the time it was handed over,
+ * since the start of the capture, then a space or tab and its payload,
+ * the rest of the line. Payloads are cut to their first 20 bytes, and
+ * shorter ones padded with spaces. Times may not decrease. Empty lines
+ * and lines starting with '#' are skipped.
+ */
+
+static void usage(char *filename) {
+  fprintf(stderr, "Usage:\n %s capture-file workload-file\n %s -d workload-file\n",
+          filename, filename);
+}
+
+/**
+ * Read a text capture into records, reporting any error in it on stderr.
+ */
+static bool read_capture(const char *path,
+                         std::vector<workload_record> *records) {
+  FILE *f = fopen(path, "r");
+  if (f == NULL) {
+    perror(path);
+    return false;
+  }
+  char *line = NULL;
+  size_t cap = 0;
+  ssize_t len;
+  int lineno = 0;
+  double last = 0.0;
+  bool ok = true;
+  while (ok && (len = getline(&line, &cap, f)) >= 0) {
+    lineno++;
+    while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+      line[--len] = '\0';
+    }
+    if (len == 0 || line[0] == '#') {
+      continue;
+    }
+    char *end;
+    workload_record r = {};
+    r.time = strtod(line, &end);
+    if (end == line || (*end != '\0' && *end != ' ' && *end != '\t') ||
+        !isfinite(r.time) || r.time < last) {
+      fprintf(stderr, "%s:%d: expected a time no earlier than %g, then the "
+              "payload\n", path, lineno, last);
+      ok = false;
+      break;
+    }
+    last = r.time;
+    char *payload = *end == '\0' ? end : end + 1;
+    size_t n = strlen(payload) < MSG_LEN ? strlen(payload) : MSG_LEN;
+    memset(r.data, ' ', MSG_LEN);
+    memcpy(r.data, payload, n);
+    records->push_back(r);
+  }
+  free(line);
+  fclose(f);
+  return ok;
+}
+
+/**
+ * Print a workload file as a text capture.
+ */
+static int dump(const char *path) {
+  struct workload w;
+  if (!workload_open(&w, path)) {
+    if (errno == EINVAL) {
+      fprintf(stderr, "%s: not a workload file\n", path);
+    } else {
+      perror(path);
+    }
+    return -1;
+  }
+  for (uint64_t i = 0; i < w.count; i++) {
+    printf("%.17g %.*s\n", w.records[i].time, MSG_LEN, w.records[i].data);
+  }
+  workload_close(&w);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  bool print = false;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "d")) != -1) {
+    switch (opt) {
+    case 'd': print = true; break;
+    default: usage(argv[0]); return -1;
+    }
+  }
+  if (optind != argc - (print ? 1 : 2)) {
+    usage(argv[0]);
+    return -1;
+  }
+  if (print) {
+    return dump(argv[optind]);
+  }
+
+  std::vector<workload_record> records;
+  if (!read_capture(argv[optind], &records)) {
+    return -1;
+  }
+  if (records.empty()) {
+    fprintf(stderr, "%s: no messages\n", argv[optind]);
+    return -1;
+  }
+  if (!workload_save(argv[optind + 1], records.data(), records.size())) {
+    perror(argv[optind + 1]);
+    return -1;
+  }
+  printf("%zu messages over %g time units\n", records.size(),
+         records.back().time);
+  return 0;
+}
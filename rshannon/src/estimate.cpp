@@ -0,0 +1,337 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <ctype.h>
+#include <getopt.h>
+#include <math.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <string>
+#include <vector>
+
+#include "../include/analytic.h"
+#include "../include/results.h"
+
+/*
+ * Analytic throughput estimates.
+ *
+ * Predicts the emulator's [PA2] throughput from the models in analytic.h
+ * in microseconds instead of simulating every event:
+ *
+ *   estimate -P gbn -w 50 -l 0.2 -c 0.2 -t 50
+ *
+ * Given experiment CSVs (as written by scripts/run_experiment_*.sh) it
+ * validates the models instead, printing one CSV line per file with the
+ * measured mean throughput, the estimate and their relative error. The
+ * protocol and window come from the file name (Exp1-GBN-loss-0.1-window-
+ * 10.csv), everything else from the file's columns.
+ *
+ * -k n checks estimates against a full simulation: n seeds of rdt are run
+ * for the point and their mean throughput reported alongside. With -e tol
+ * only the CSV points whose estimate is off by more than tol (a fraction)
+ * are simulated, so the models' weak spots get checked automatically.
+ */
+
+static const char *bindir = "."; // -b where rdt lives
+static int verify_seeds = 0;     // -k
+static double tolerance = -1.0;  // -e, negative to verify every point
+
+static void usage(char *filename) {
+  fprintf(stderr, "Usage:\n %s [-P Protocol] [-w Window size] "
+                  "[-m Messages] [-l Loss] [-c Corruption] "
+                  "[-t Time between messages] [-T Timeout] "
+                  "[-k Seeds to simulate] [-e Error tolerance] "
+                  "[-b Simulator binary directory] [experiment.csv ...]\n",
+          filename);
+}
+
+static double now_us() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static std::vector<std::string> split(const std::string &s, const char *sep) {
+  std::vector<std::string> out;
+  size_t start = 0;
+  for (;;) {
+    size_t end = s.find_first_of(sep, start);
+    out.push_back(s.substr(start, end - start));
+    if (end == std::string::npos) {
+      return out;
+    }
+    start = end + 1;
+  }
+}
+
+static std::string arg(double value) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%.17g", value);
+  return buf;
+}
+
+/**
+ * Run seeds 1..n of rdt on a point, all at once.
+ *
+ * @return the mean throughput, or a negative value if no run succeeded
+ */
+static double simulate(const struct analytic_params *p, int n) {
+  char path[] = "/tmp/estimate-XXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0) {
+    perror("mkstemp");
+    return -1.0;
+  }
+  close(fd);
+
+  std::string binary = std::string(bindir) + "/rdt";
+  for (int seed = 1; seed <= n; seed++) {
+    std::vector<std::string> args;
+    args.push_back(binary);
+    args.push_back("-P"); args.push_back(p->protocol);
+    args.push_back("-s"); args.push_back(arg(seed));
+    args.push_back("-w"); args.push_back(arg(p->window));
+    args.push_back("-m"); args.push_back(arg(p->messages));
+    args.push_back("-l"); args.push_back(arg(p->loss));
+    args.push_back("-c"); args.push_back(arg(p->corrupt));
+    args.push_back("-t"); args.push_back(arg(p->lambda));
+    args.push_back("-v"); args.push_back("0");
+    args.push_back("-o"); args.push_back(path);
+    if (fork() != 0) {
+      continue;
+    }
+    int null = open("/dev/null", O_WRONLY);
+    if (null >= 0) {
+      dup2(null, STDOUT_FILENO);
+      close(null);
+    }
+    std::vector<char *> argv;
+    for (size_t i = 0; i < args.size(); i++) {
+      argv.push_back((char *)args[i].c_str());
+    }
+    argv.push_back(NULL);
+    execv(argv[0], &argv[0]);
+    _exit(127);
+  }
+  while (wait(NULL) > 0) {
+  }
+
+  double sum = 0.0;
+  int runs = 0;
+  results_reader *r = results_read_open(path);
+  while (r != NULL && results_next_group(r) == 1) {
+    const double *throughput = results_f64(r, "throughput");
+    for (uint32_t i = 0; throughput != NULL && i < r->nrows; i++) {
+      sum += throughput[i];
+      runs++;
+    }
+  }
+  if (r != NULL) {
+    results_read_close(r);
+  }
+  unlink(path);
+  if (runs < n) {
+    fprintf(stderr, "%d of %d simulations of %s failed\n", n - runs, n,
+            p->protocol);
+  }
+  return runs > 0 ? sum / runs : -1.0;
+}
+
+/**
+ * Estimate a point and time the estimate.
+ */
+static bool estimate(const struct analytic_params *p,
+                     struct analytic_estimate *e, double *us) {
+  double start = now_us();
+  bool ok = analytic_run(p, e);
+  *us = now_us() - start;
+  return ok;
+}
+
+/**
+ * Read a point and its mean measured throughput from an experiment CSV.
+ */
+static bool read_experiment(const char *path, std::string &protocol,
+                            struct analytic_params *p, double *measured) {
+  const char *base = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+  std::vector<std::string> words = split(base, "-.");
+  protocol.clear();
+  p->window = 1;
+  for (size_t i = 0; i < words.size(); i++) {
+    std::string w = words[i];
+    for (size_t j = 0; j < w.size(); j++) {
+      w[j] = tolower(w[j]);
+    }
+    if (analytic_timeout(w.c_str()) > 0.0) {
+      protocol = w;
+    } else if (w == "window" && i + 1 < words.size()) {
+      p->window = atoi(words[i + 1].c_str());
+    }
+  }
+  if (protocol.empty()) {
+    fprintf(stderr, "%s: no protocol in the file name\n", path);
+    return false;
+  }
+
+  FILE *f = fopen(path, "r");
+  if (f == NULL) {
+    perror(path);
+    return false;
+  }
+  char line[1024];
+  std::vector<std::string> header;
+  int messages = -1, loss = -1, corrupt = -1, lambda = -1, throughput = -1;
+  int rows = 0;
+  double sum = 0.0;
+  while (fgets(line, sizeof(line), f) != NULL) {
+    line[strcspn(line, "\r\n")] = '\0';
+    std::vector<std::string> fields = split(line, ",");
+    if (header.empty()) {
+      header = fields;
+      for (size_t c = 0; c < header.size(); c++) {
+        if (header[c] == "Messages") messages = c;
+        if (header[c] == "Loss") loss = c;
+        if (header[c] == "Corruption") corrupt = c;
+        if (header[c] == "Time_bw_messages") lambda = c;
+        if (header[c] == "Throughput") throughput = c;
+      }
+      if (messages < 0 || loss < 0 || corrupt < 0 || lambda < 0 ||
+          throughput < 0) {
+        break;
+      }
+      continue;
+    }
+    // Skip the summary row the experiment scripts append
+    if (fields.size() != header.size() || fields[0].empty()) {
+      continue;
+    }
+    p->messages = atoi(fields[messages].c_str());
+    p->loss = atof(fields[loss].c_str());
+    p->corrupt = atof(fields[corrupt].c_str());
+    p->lambda = atof(fields[lambda].c_str());
+    sum += atof(fields[throughput].c_str());
+    rows++;
+  }
+  fclose(f);
+  if (rows == 0) {
+    fprintf(stderr, "%s: not an experiment results file\n", path);
+    return false;
+  }
+  *measured = sum / rows;
+  return true;
+}
+
+static void print_estimate(const struct analytic_params *p,
+                           const struct analytic_estimate *e, double us) {
+  printf("Protocol %s, window %d, %d msgs, loss %f, corruption %f, "
+         "lambda %f\n",
+         p->protocol, p->window, p->messages, p->loss, p->corrupt, p->lambda);
+  printf("Estimated throughput: %f packets/time units (limited by %s)\n",
+         e->throughput, e->bound);
+  printf(" service time %f time units, %f packets sent per message, "
+         "capacity %f packets/time units\n",
+         e->service_time, e->transmissions, e->capacity);
+  if (e->collapse > 0.0) {
+    printf(" bistable: drops to %f packets/time units if the window fills\n",
+           e->collapse);
+  }
+  printf(" estimated in %.1f us\n", us);
+}
+
+/**
+ * Validate the models against experiment CSVs.
+ */
+static int validate(int nfiles, char **files, double timeout) {
+  int points = 0, verified = 0;
+  double total_error = 0.0, total_us = 0.0;
+
+  printf("File,Protocol,Window,Messages,Loss,Corruption,Time_bw_messages,"
+         "Measured,Estimated,Error,Simulated,Simulated_error\n");
+  for (int i = 0; i < nfiles; i++) {
+    std::string protocol;
+    struct analytic_params p;
+    struct analytic_estimate e;
+    double measured, us;
+    p.timeout = timeout;
+    if (!read_experiment(files[i], protocol, &p, &measured)) {
+      continue;
+    }
+    p.protocol = protocol.c_str();
+    estimate(&p, &e, &us);
+    double error = measured > 0.0 ? (e.throughput - measured) / measured : 0.0;
+    points++;
+    total_error += fabs(error);
+    total_us += us;
+    printf("%s,%s,%d,%d,%f,%f,%f,%f,%f,%f,", files[i], p.protocol, p.window,
+           p.messages, p.loss, p.corrupt, p.lambda, measured, e.throughput,
+           error);
+    if (verify_seeds > 0 && fabs(error) > tolerance) {
+      double simulated = simulate(&p, verify_seeds);
+      if (simulated > 0.0) {
+        printf("%f,%f", simulated, (e.throughput - simulated) / simulated);
+        verified++;
+      }
+    }
+    printf("\n");
+    fflush(stdout);
+  }
+  if (points == 0) {
+    return -1;
+  }
+  fprintf(stderr, "%d points, mean absolute error %.1f%%, %d simulated, "
+                  "%.1f us per estimate\n",
+          points, 100 * total_error / points, verified, total_us / points);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  struct analytic_params p = {NULL, 10, 1000, 0.0, 0.0, 50.0, 0.0};
+  struct analytic_estimate e;
+  double us;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "P:w:m:l:c:t:T:k:e:b:")) != -1) {
+    switch (opt) {
+    case 'P': p.protocol = optarg; break;
+    case 'w': p.window = atoi(optarg); break;
+    case 'm': p.messages = atoi(optarg); break;
+    case 'l': p.loss = atof(optarg); break;
+    case 'c': p.corrupt = atof(optarg); break;
+    case 't': p.lambda = atof(optarg); break;
+    case 'T': p.timeout = atof(optarg); break;
+    case 'k': verify_seeds = atoi(optarg); break;
+    case 'e': tolerance = atof(optarg); break;
+    case 'b': bindir = optarg; break;
+    default: usage(argv[0]); return -1;
+    }
+  }
+  if (p.window < 1 || p.messages < 1 || p.lambda <= 0.0 || p.loss < 0.0 ||
+      p.loss > 1.0 || p.corrupt < 0.0 || p.corrupt > 1.0) {
+    fprintf(stderr, "Invalid arguments!\n");
+    usage(argv[0]);
+    return -1;
+  }
+  if (optind < argc) {
+    return validate(argc - optind, argv + optind, p.timeout);
+  }
+
+  if (p.protocol == NULL || !estimate(&p, &e, &us)) {
+    fprintf(stderr, "Unknown protocol, use -P abt|gbn|sr\n");
+    usage(argv[0]);
+    return -1;
+  }
+  print_estimate(&p, &e, us);
+  if (verify_seeds > 0) {
+    double simulated = simulate(&p, verify_seeds);
+    if (simulated < 0.0) {
+      return -1;
+    }
+    printf("Simulated throughput: %f packets/time units over %d seeds "
+           "(estimate off by %.1f%%)\n",
+           simulated, verify_seeds,
+           100 * (e.throughput - simulated) / simulated);
+  }
+  return 0;
+}
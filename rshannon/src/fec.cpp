@@ -0,0 +1,281 @@
+#include <string.h>
+
+#include "../include/fec.h"
+
+int fec_parity_sent = 0;
+int fec_recovered = 0;
+
+/* GF(2^8) with the Reed-Solomon polynomial x^8 + x^4 + x^3 + x^2 + 1 */
+static unsigned char gf_exp[512];
+static unsigned char gf_log[256];
+static bool gf_ready = false;
+
+static void gf_init() {
+  int x = 1;
+  if (gf_ready) {
+    return;
+  }
+  for (int i = 0; i < 255; i++) {
+    gf_exp[i] = gf_exp[i + 255] = x;
+    gf_log[x] = i;
+    x <<= 1;
+    if (x & 0x100) {
+      x ^= 0x11d;
+    }
+  }
+  gf_ready = true;
+}
+
+static unsigned char gf_mul(unsigned char a, unsigned char b) {
+  return a == 0 || b == 0 ? 0 : gf_exp[gf_log[a] + gf_log[b]];
+}
+
+static unsigned char gf_inv(unsigned char a) { return gf_exp[255 - gf_log[a]]; }
+
+/**
+ * Coefficient of data packet i in parity packet j: all ones (XOR) for a
+ * single parity packet, a Cauchy matrix otherwise.
+ */
+static unsigned char coefficient(int r, int j, int i) {
+  return r == 1 ? 1 : gf_inv((FEC_MAX_BLOCK + j) ^ i);
+}
+
+/**
+ * dst += c * src, over a payload.
+ */
+static void add_scaled(unsigned char *dst, const unsigned char *src,
+                       unsigned char c) {
+  for (int b = 0; b < MSG_LEN; b++) {
+    dst[b] ^= gf_mul(c, src[b]);
+  }
+}
+
+static int clamp(int value, int max) {
+  return value < 0 ? 0 : value > max ? max : value;
+}
+
+void fec_encoder_init(struct fec_encoder *e, int k, int r) {
+  e->k = clamp(k, FEC_MAX_BLOCK);
+  e->r = clamp(r, FEC_MAX_PARITY);
+  if (e->r == 0) {
+    e->k = 0;
+  }
+  e->block = -1;
+  e->count = 0;
+}
+
+void fec_decoder_init(struct fec_decoder *d, int k, int r) {
+  d->k = clamp(k, FEC_MAX_BLOCK);
+  d->r = clamp(r, FEC_MAX_PARITY);
+  if (d->r == 0) {
+    d->k = 0;
+  }
+  d->blocks.clear();
+}
+
+void fec_reconfigure(struct fec_encoder *e, struct fec_decoder *d, int k,
+                     int r) {
+  struct fec_encoder want;
+  fec_encoder_init(&want, k, r);
+  if (want.k != e->k || want.r != e->r) {
+    *e = want;
+    fec_decoder_init(d, k, r);
+  }
+}
+
+bool fec_is_parity(struct pkt packet) { return packet.acknum < 0; }
+
+int fec_encode(struct fec_encoder *e, struct pkt packet, struct pkt *parity) {
+  if (e->k == 0 || packet.seqnum < 1) {
+    return 0;
+  }
+  gf_init();
+  int block = (packet.seqnum - 1) / e->k, i = (packet.seqnum - 1) % e->k;
+  if (block != e->block) {
+    e->block = block;
+    e->count = 0;
+    memset(e->parity, 0, sizeof(e->parity));
+  }
+  if (i != e->count) {
+    e->count = -1; // A gap: this block gets no parity
+    return 0;
+  }
+  for (int j = 0; j < e->r; j++) {
+    add_scaled(e->parity[j], (const unsigned char *)packet.payload,
+               coefficient(e->r, j, i));
+  }
+  if (++e->count < e->k) {
+    return 0;
+  }
+  for (int j = 0; j < e->r; j++) {
+    memset(&parity[j], 0, sizeof(parity[j]));
+    parity[j].seqnum = 1 + block * e->k;
+    parity[j].acknum = FEC_PARITY(j, e->k, e->r);
+    memcpy(parity[j].payload, e->parity[j], MSG_LEN);
+  }
+  e->count = -1;
+  fec_parity_sent += e->r;
+  return e->r;
+}
+
+/**
+ * The decoder's record of a block, created if it is newer than the oldest
+ * one kept.
+ *
+ * @return the block, or NULL if it is too old to track
+ */
+static struct fec_block *find_block(struct fec_decoder *d, int block) {
+  std::deque<fec_block>::iterator it = d->blocks.begin();
+  while (it != d->blocks.end() && it->block < block) {
+    ++it;
+  }
+  if (it != d->blocks.end() && it->block == block) {
+    return &*it;
+  }
+  if (d->blocks.size() == FEC_MAX_BLOCKS) {
+    if (it == d->blocks.begin()) {
+      return NULL;
+    }
+    d->blocks.pop_front(); // Forget the oldest block
+    it = d->blocks.begin();
+    while (it != d->blocks.end() && it->block < block) {
+      ++it;
+    }
+  }
+  struct fec_block b;
+  memset(&b, 0, sizeof(b));
+  b.block = block;
+  return &*d->blocks.insert(it, b);
+}
+
+/**
+ * Solve for the m missing data packets of a block from m of its parity
+ * packets, by Gaussian elimination over GF(2^8).
+ */
+static void solve(const struct fec_decoder *d, struct fec_block *b,
+                  const int *missing, int m) {
+  unsigned char a[FEC_MAX_PARITY][FEC_MAX_PARITY];
+  unsigned char s[FEC_MAX_PARITY][MSG_LEN];
+  int row = 0;
+
+  // Each parity packet, less the data packets held, is a combination of
+  // the missing ones only
+  for (int j = 0; j < d->r && row < m; j++) {
+    if (!(b->checks & (1u << j))) {
+      continue;
+    }
+    memcpy(s[row], b->parity[j], MSG_LEN);
+    for (int i = 0; i < d->k; i++) {
+      if (b->received & (1u << i)) {
+        add_scaled(s[row], b->data[i], coefficient(d->r, j, i));
+      }
+    }
+    for (int t = 0; t < m; t++) {
+      a[row][t] = coefficient(d->r, j, missing[t]);
+    }
+    row++;
+  }
+
+  for (int col = 0; col < m; col++) {
+    int pivot = col;
+    while (a[pivot][col] == 0) {
+      pivot++;
+    }
+    if (pivot != col) {
+      unsigned char tmp[MSG_LEN];
+      for (int t = 0; t < m; t++) {
+        unsigned char x = a[col][t];
+        a[col][t] = a[pivot][t];
+        a[pivot][t] = x;
+      }
+      memcpy(tmp, s[col], MSG_LEN);
+      memcpy(s[col], s[pivot], MSG_LEN);
+      memcpy(s[pivot], tmp, MSG_LEN);
+    }
+    unsigned char scale = gf_inv(a[col][col]);
+    for (int t = 0; t < m; t++) {
+      a[col][t] = gf_mul(a[col][t], scale);
+    }
+    for (int byte = 0; byte < MSG_LEN; byte++) {
+      s[col][byte] = gf_mul(s[col][byte], scale);
+    }
+    for (int other = 0; other < m; other++) {
+      unsigned char c = a[other][col];
+      if (other == col || c == 0) {
+        continue;
+      }
+      for (int t = 0; t < m; t++) {
+        a[other][t] ^= gf_mul(c, a[col][t]);
+      }
+      add_scaled(s[other], s[col], c);
+    }
+  }
+
+  for (int t = 0; t < m; t++) {
+    memcpy(b->data[missing[t]], s[t], MSG_LEN);
+    b->received |= 1u << missing[t];
+  }
+}
+
+int fec_decode(struct fec_decoder *d, struct pkt packet, struct pkt *out) {
+  if (d->k == 0 || packet.seqnum < 1) {
+    return 0;
+  }
+  gf_init();
+  int block = (packet.seqnum - 1) / d->k, j = 0;
+  if (fec_is_parity(packet)) {
+    int v = -1 - packet.acknum;
+    int r = v / FEC_MAX_PARITY % 256, k = v / FEC_MAX_PARITY / 256;
+    j = v % FEC_MAX_PARITY;
+    if (k != d->k || r != d->r || j >= r || (packet.seqnum - 1) % k != 0) {
+      return 0; // Built for another block size
+    }
+  }
+  struct fec_block *b = find_block(d, block);
+  if (b == NULL) {
+    return 0;
+  }
+  if (fec_is_parity(packet)) {
+    memcpy(b->parity[j], packet.payload, MSG_LEN);
+    b->checks |= 1u << j;
+  } else {
+    int i = (packet.seqnum - 1) % d->k;
+    memcpy(b->data[i], packet.payload, MSG_LEN);
+    b->received |= 1u << i;
+  }
+
+  int missing[FEC_MAX_BLOCK], m = 0;
+  for (int i = 0; i < d->k; i++) {
+    if (!(b->received & (1u << i))) {
+      missing[m++] = i;
+    }
+  }
+  if (m == 0 || m > __builtin_popcount(b->checks)) {
+    return 0;
+  }
+  solve(d, b, missing, m);
+  for (int t = 0; t < m; t++) {
+    memset(&out[t], 0, sizeof(out[t]));
+    out[t].seqnum = 1 + block * d->k + missing[t];
+    memcpy(out[t].payload, b->data[missing[t]], MSG_LEN);
+  }
+  fec_recovered += m;
+  return m;
+}
+
+bool fec_lookup(const struct fec_decoder *d, int seqnum, struct pkt *out) {
+  if (d->k == 0 || seqnum < 1) {
+    return false;
+  }
+  int block = (seqnum - 1) / d->k, i = (seqnum - 1) % d->k;
+  for (std::deque<fec_block>::const_iterator it = d->blocks.begin();
+       it != d->blocks.end() && it->block <= block; ++it) {
+    if (it->block == block && (it->received & (1u << i))) {
+      memset(out, 0, sizeof(*out));
+      out->seqnum = seqnum;
+      memcpy(out->payload, it->data[i], MSG_LEN);
+      return true;
+    }
+  }
+  return false;
+}
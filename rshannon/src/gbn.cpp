@@ -1,11 +1,14 @@
 #include "../include/packet.h"
 #include "../include/gbn.h"
 #include "../include/simulator.h"
+#include "../include/protocol.h"
+#include "../include/checkpoint.h"
 #include <cstring>
 #include <iostream>
 #include <algorithm>
 
 #define DEBUG_MODE 0 // Whether debugging mode is enabled or disabled
+#define PACE_SLACK 1e-6 // Relative error in a time the timer went off at
 #define DEBUG(x)                                                               \
   do {                                                                         \
     if (DEBUG_MODE) {                                                          \
@@ -13,6 +16,28 @@
     }                                                                          \
   } while (0) // http://stackoverflow.com/questions/14251038/debug-macros-in-c
 
+namespace gbn {
+
+/* Protocol state, documented in gbn.h */
+std::vector<struct pkt> unacked_buf;
+std::vector<struct pkt> unsent_buf;
+float timer_interval;
+int base;
+int next_seq_num;
+int window_size;
+int expected_seq_num;
+int rwnd;
+struct fec_encoder fec_tx;
+struct fec_decoder fec_rx;
+int pace_burst;
+std::deque<struct pkt> paced_buf;
+float pace_next;
+float rto_at;
+float srtt;
+int rtt_seq;
+float rtt_sent;
+int rtt_next;
+
 /**
  * Construct a packet.
  *
@@ -95,6 +120,117 @@ bool is_corrupt(struct pkt packet) {
  */
 bool sort_by_seq(const pkt &a, const pkt &b) { return a.seqnum < b.seqnum; }
 
+/**
+ * Send a packet for the first time, followed by its block's parity
+ * packets if it completes one.
+ *
+ * @param packet the packet to send
+ */
+void send_new(struct pkt packet) {
+  struct pkt parity[FEC_MAX_PARITY];
+  transmit(packet);
+  int n = fec_encode(&fec_tx, packet, parity);
+  for (int i = 0; i < n; i++) {
+    parity[i].checksum = checksum(parity[i]);
+    DEBUG("sender: sent parity " << i << " of block at " << parity[i].seqnum);
+    transmit(parity[i]);
+  }
+}
+
+/**
+ * Start timing a packet's round trip, if it is a first transmission and
+ * none is being timed already.
+ *
+ * @param packet the packet being sent
+ */
+void rtt_start(struct pkt packet) {
+  if (rtt_seq == 0 && packet.seqnum >= rtt_next && !fec_is_parity(packet)) {
+    rtt_seq = packet.seqnum;
+    rtt_sent = get_sim_time();
+    rtt_next = packet.seqnum + 1;
+  }
+}
+
+/**
+ * Stop timing on a timeout: the packet being timed may be resent, and
+ * its ACK would not say which copy it answers (Karn's algorithm).
+ */
+void rtt_cancel() {
+  rtt_seq = 0;
+  if (!unacked_buf.empty()) {
+    rtt_next = std::max(rtt_next, unacked_buf.back().seqnum + 1);
+  }
+}
+
+/**
+ * Whether a time has come, allowing for the rounding of the time the
+ * timer was set for.
+ */
+bool due(float at) {
+  float now = get_sim_time();
+  return at <= now + PACE_SLACK * std::max(now, 1.0f);
+}
+
+/**
+ * Time between paced packets: the window spread over a round trip.
+ */
+float pace_gap() { return srtt / std::max(usable_window(), 1); }
+
+/**
+ * When the packet at the front of paced_buf may go.
+ */
+float pace_slot() { return pace_next - (pace_burst - 1) * pace_gap(); }
+
+/**
+ * Hand a packet A sends to the network, or to the pacer when it is on.
+ *
+ * @param packet the packet to send
+ */
+void transmit(struct pkt packet) {
+  if (pace_burst == 0) {
+    rtt_start(packet);
+    tolayer3(0, packet);
+    return;
+  }
+  paced_buf.push_back(packet);
+  pace();
+}
+
+/**
+ * Send every packet in paced_buf whose slot has come.
+ */
+void pace() {
+  float now = get_sim_time();
+  while (!paced_buf.empty() && due(pace_slot())) {
+    struct pkt packet = paced_buf.front();
+    paced_buf.pop_front();
+    DEBUG("sender: paced packet " << packet.seqnum << " sent");
+    rtt_start(packet);
+    tolayer3(0, packet);
+    pace_next = std::max(pace_next, now) + pace_gap();
+    rto_at = std::max(rto_at, now + timer_interval);
+  }
+}
+
+/**
+ * Start A's timer for the next slot or the timeout, whichever is sooner.
+ */
+void pace_timer() {
+  float at = rto_at;
+  if (!paced_buf.empty()) {
+    at = std::min(at, pace_slot());
+  }
+  starttimer(0, std::max(at - get_sim_time(), 0.0f));
+}
+
+/**
+ * Whether a packet waiting for the pacer has been acknowledged since it
+ * was queued, and need not be sent.
+ */
+bool is_acked(const pkt &packet) {
+  return !fec_is_parity(packet) && packet.seqnum < base;
+}
+
 /**
  * Mark a packet as unacknowledged.
  *
@@ -115,28 +251,54 @@ void unsent(struct pkt packet) {
   std::sort(unsent_buf.begin(), unsent_buf.end(), sort_by_seq);
 }
 
+/**
+ * The most packets A may have outstanding: its own window, or less if B
+ * has advertised less room.
+ */
+int usable_window() { return std::min(window_size, rwnd); }
+
+/**
+ * The messages A is holding, sent or waiting for the window.
+ */
+int backlog() { return unacked_buf.size() + unsent_buf.size(); }
+
 /**
  * Called when an application has a message ready to sent
- * out through the network.
+ * out through the network. Messages beyond the window wait in the
+ * unsent buffer, which is only bounded if the emulator gave A a send
+ * buffer; a full one refuses the message.
  *
  * @param message the message to send
+ * @return        false if the message was not taken
  */
-void A_output(struct msg message) {
-  if (next_seq_num < base + window_size) {
+bool A_output(struct msg message) {
+  if (getbufsize() > 0 && backlog() >= getbufsize()) {
+    DEBUG("sender: send buffer full, refusing message");
+    return false;
+  }
+  if (unsent_buf.empty() && next_seq_num < base + usable_window()) {
     struct pkt packet = make_pkt(next_seq_num, 0, message);
     DEBUG("sender: sent pkt " << next_seq_num);
-    tolayer3(0, packet);
+    send_new(packet);
     next_seq_num++;
     unacked(packet);
     if (base == next_seq_num) {
       stoptimer(0);
       starttimer(0, timer_interval);
     }
+    if (!paced_buf.empty()) {
+      // The timer may now be due sooner, for the packet's slot
+      stoptimer(0);
+      pace_timer();
+    }
   } else {
+    // Messages that wait take their sequence number now, in order
     struct pkt packet = make_pkt(next_seq_num, 0, message);
+    next_seq_num++;
     unsent(packet);
   }
   DEBUG("num unacked: " << unacked_buf.size());
+  return true;
 }
 
 /**
@@ -162,16 +324,16 @@ void cumulative_ack(int seq_num) {
  * allowable by the window size.
  */
 void fill_sender_window() {
-  int num_to_send = window_size - unacked_buf.size();
+  int num_to_send = usable_window() - unacked_buf.size();
   int num_unsent = unsent_buf.size();
-  if (num_to_send == 0 || unsent_buf.size() == 0) {
+  if (num_to_send <= 0 || unsent_buf.size() == 0) {
     return;
   }
   if (num_to_send > num_unsent) {
     num_to_send = num_unsent;
   }
   for (int i = 0; i < num_to_send; i++) {
-    tolayer3(0, unsent_buf[i]);
+    send_new(unsent_buf[i]);
     unacked(unsent_buf[i]);
   }
   for (int i = 0; i < num_to_send; i++) {
@@ -180,7 +342,8 @@ void fill_sender_window() {
 }
 
 /**
- * Called when host A received a packet from the network.
+ * Called when host A received a packet from the network. Every ACK
+ * carries the room B has left, which caps the window from then on.
  *
  * @param packet the packet received from the network
  */
@@ -188,27 +351,81 @@ void A_input(struct pkt packet) {
   if (is_corrupt(packet)) {
     return;
   }
+  if (rtt_seq > 0 && packet.acknum >= rtt_seq) {
+    srtt += (get_sim_time() - rtt_sent - srtt) / 8;
+    rtt_seq = 0;
+  }
+  memcpy(&rwnd, packet.payload, sizeof(rwnd));
   base = packet.acknum + 1;
   cumulative_ack(packet.acknum);
+  if (pace_burst > 0) {
+    paced_buf.erase(std::remove_if(paced_buf.begin(), paced_buf.end(),
+                                   is_acked),
+                    paced_buf.end());
+    rto_at = get_sim_time() + timer_interval;
+  }
   fill_sender_window();
   stoptimer(0);
-  starttimer(0, timer_interval);
+  if (pace_burst > 0) {
+    // A new estimate or window may have brought the next slot forward
+    pace();
+    pace_timer();
+  } else {
+    starttimer(0, timer_interval);
+  }
 }
 
 /**
  * Called whenever a "hardware" timer interrupt occurs.
  * (Note that within a simulated environment like this
  * there is no true hardware timer present.)
+ *
+ * If B has closed its window and nothing is outstanding, no ACK will
+ * come to reopen it, so the next waiting packet is sent anyway as a
+ * probe: B drops it while it has no room, and its ACK says when it has.
  */
 void A_timerinterrupt() {
+  if (pace_burst > 0) {
+    A_paced_timerinterrupt();
+    return;
+  }
+  rtt_cancel();
   for (int i = 0; i < unacked_buf.size(); i++) {
     DEBUG("sender: re-sending packet " << unacked_buf[i].seqnum
                                        << " due to timeout");
     tolayer3(0, unacked_buf[i]);
   }
+  if (rwnd <= 0 && unacked_buf.empty() && !unsent_buf.empty()) {
+    DEBUG("sender: probing closed window with " << unsent_buf[0].seqnum);
+    send_new(unsent_buf[0]);
+    unacked(unsent_buf[0]);
+    unsent_buf.erase(unsent_buf.begin());
+  }
   starttimer(0, timer_interval);
 }
 
+/**
+ * A_timerinterrupt with pacing on. The timer went off for the next slot,
+ * or for a timeout, which queues the whole window to be resent at the
+ * pacer's rate rather than all at once.
+ */
+void A_paced_timerinterrupt() {
+  if (due(rto_at)) {
+    DEBUG("sender: timeout, pacing out " << unacked_buf.size() << " packets");
+    rtt_cancel();
+    paced_buf.assign(unacked_buf.begin(), unacked_buf.end());
+    rto_at = get_sim_time() + timer_interval;
+    if (rwnd <= 0 && unacked_buf.empty() && !unsent_buf.empty()) {
+      DEBUG("sender: probing closed window with " << unsent_buf[0].seqnum);
+      send_new(unsent_buf[0]);
+      unacked(unsent_buf[0]);
+      unsent_buf.erase(unsent_buf.begin());
+    }
+  }
+  pace();
+  pace_timer();
+}
+
 /**
  * Initialization for sender once simulation begins.
  */
@@ -216,19 +433,37 @@ void A_init() {
   base = 1;
   next_seq_num = 1;
   window_size = getwinsize();
+  rwnd = window_size;
   timer_interval = 11.0;
+  fec_encoder_init(&fec_tx, getfecblock(), getfecparity());
+  pace_burst = getpacing();
+  paced_buf.clear();
+  pace_next = 0.0;
+  rto_at = timer_interval;
+  srtt = timer_interval;
+  rtt_seq = 0;
+  rtt_next = 1;
   // Start hardware timer
   starttimer(0, timer_interval);
 }
 
+/**
+ * Room left in B's receive buffer, which holds window_size messages
+ * including those delivered that its application has not read yet.
+ */
+int receive_room() { return std::max(window_size - getunread(), 0); }
+
 /**
  * Acknowledge a received packet. Constructs and
- * sends an ACK packet to the sender.
+ * sends an ACK packet to the sender, advertising the
+ * room B has left in its payload.
  *
  * @param seq_num the sequence number of the packet to acknowledge
  */
 void ack(int seq_num) {
   struct msg ack_msg = {};
+  int room = receive_room();
+  memcpy(ack_msg.data, &room, sizeof(room));
   struct pkt ack_pkt = make_pkt(0, seq_num, ack_msg);
   tolayer3(1, ack_pkt);
 }
@@ -243,7 +478,17 @@ void B_input(struct pkt packet) {
     ack(expected_seq_num);
     return;
   }
+  if (fec_rx.k > 0) {
+    B_fec_input(packet);
+    return;
+  }
 
+  if (packet.seqnum == expected_seq_num && receive_room() == 0) {
+    // Answered like an out of order packet, so A keeps it to resend
+    DEBUG("receiver: no room for packet " << packet.seqnum);
+    ack(expected_seq_num);
+    return;
+  }
   if (packet.seqnum == expected_seq_num) {
     tolayer5(1, packet.payload);
     ack(packet.seqnum);
@@ -254,7 +499,119 @@ void B_input(struct pkt packet) {
   ack(expected_seq_num);
 }
 
+/**
+ * B_input with FEC on: pass an intact packet through the decoder and
+ * deliver every packet it now holds in order. As without FEC, B ACKs the
+ * last packet delivered, or repeats its ACK for an out of order one.
+ *
+ * @param packet the packet from the network
+ */
+void B_fec_input(struct pkt packet) {
+  struct pkt recovered[FEC_MAX_PARITY], held;
+  bool parity = fec_is_parity(packet);
+  int last = -1;
+
+  fec_decode(&fec_rx, packet, recovered);
+  if (receive_room() == 0) {
+    // Held packets wait in the decoder until the application reads
+    if (!parity) {
+      ack(expected_seq_num);
+    }
+    return;
+  }
+  if (!parity && packet.seqnum == expected_seq_num) {
+    tolayer5(1, packet.payload);
+    last = expected_seq_num++;
+  }
+  while (receive_room() > 0 && fec_lookup(&fec_rx, expected_seq_num, &held)) {
+    DEBUG("receiver: delivering held packet " << expected_seq_num);
+    tolayer5(1, held.payload);
+    last = expected_seq_num++;
+  }
+  if (last >= 0) {
+    ack(last);
+  } else if (!parity) {
+    ack(expected_seq_num);
+  }
+}
+
 /**
  * Initialization for receiver once simulation begins.
  */
-void B_init() { expected_seq_num = 1; }
+void B_init() {
+  expected_seq_num = 1;
+  fec_decoder_init(&fec_rx, getfecblock(), getfecparity());
+}
+
+
+/**
+ * Write the protocol state to a checkpoint.
+ *
+ * @param f the checkpoint file
+ */
+void save_state(FILE *f) {
+  ckpt_put_seq(f, unacked_buf);
+  ckpt_put_seq(f, unsent_buf);
+  ckpt_put(f, timer_interval);
+  ckpt_put(f, base);
+  ckpt_put(f, next_seq_num);
+  ckpt_put(f, window_size);
+  ckpt_put(f, expected_seq_num);
+  ckpt_put(f, rwnd);
+  ckpt_put(f, fec_tx);
+  ckpt_put(f, fec_rx.k);
+  ckpt_put(f, fec_rx.r);
+  ckpt_put_seq(f, fec_rx.blocks);
+  ckpt_put(f, pace_burst);
+  ckpt_put_seq(f, paced_buf);
+  ckpt_put(f, pace_next);
+  ckpt_put(f, rto_at);
+  ckpt_put(f, srtt);
+  ckpt_put(f, rtt_seq);
+  ckpt_put(f, rtt_sent);
+  ckpt_put(f, rtt_next);
+}
+
+/**
+ * Read back the protocol state written by save_state.
+ *
+ * @param  f the checkpoint file
+ * @return   false if the checkpoint is truncated
+ */
+bool load_state(FILE *f) {
+  return ckpt_get_seq(f, unacked_buf) && ckpt_get_seq(f, unsent_buf) &&
+         ckpt_get(f, timer_interval) && ckpt_get(f, base) &&
+         ckpt_get(f, next_seq_num) && ckpt_get(f, window_size) &&
+         ckpt_get(f, expected_seq_num) && ckpt_get(f, rwnd) &&
+         ckpt_get(f, fec_tx) &&
+         ckpt_get(f, fec_rx.k) && ckpt_get(f, fec_rx.r) &&
+         ckpt_get_seq(f, fec_rx.blocks) && ckpt_get(f, pace_burst) &&
+         ckpt_get_seq(f, paced_buf) && ckpt_get(f, pace_next) &&
+         ckpt_get(f, rto_at) && ckpt_get(f, srtt) && ckpt_get(f, rtt_seq) &&
+         ckpt_get(f, rtt_sent) && ckpt_get(f, rtt_next);
+}
+
+/**
+ * Called when the emulator's parameters change mid-run. A smaller window
+ * takes effect as the packets already outstanding are acknowledged, and
+ * is what B advertises from its next ACK. A new
+ * FEC block size starts both sides afresh. Turning pacing off sends
+ * whatever the pacer holds at once; turning it on starts the timeout
+ * afresh.
+ */
+void reconfigure() {
+  window_size = getwinsize();
+  fec_reconfigure(&fec_tx, &fec_rx, getfecblock(), getfecparity());
+  if (getpacing() == 0) {
+    for (size_t i = 0; i < paced_buf.size(); i++) {
+      tolayer3(0, paced_buf[i]);
+    }
+    paced_buf.clear();
+  } else if (pace_burst == 0) {
+    rto_at = get_sim_time() + timer_interval;
+    pace_next = get_sim_time();
+  }
+  pace_burst = getpacing();
+}
+
+} // namespace gbn
@@ -0,0 +1,95 @@
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../include/metrics.h"
+
+/**
+ * Bytes of the page the sequence lock covers: everything after seq.
+ */
+#define BODY_OFFSET (offsetof(metrics_page, seq) + sizeof(uint32_t))
+#define BODY_SIZE (sizeof(metrics_page) - BODY_OFFSET)
+
+static size_t page_size() {
+  long size = sysconf(_SC_PAGESIZE);
+  return size > (long)sizeof(metrics_page) ? size : sizeof(metrics_page);
+}
+
+struct metrics_page *metrics_create(const char *path) {
+  int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return NULL;
+  }
+  if (ftruncate(fd, page_size()) < 0) {
+    close(fd);
+    return NULL;
+  }
+  void *p = mmap(NULL, page_size(), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) {
+    return NULL;
+  }
+  struct metrics_page *page = (struct metrics_page *)p;
+  page->seq = 1;
+  __sync_synchronize();
+  page->magic = METRICS_MAGIC;
+  page->version = METRICS_VERSION;
+  __sync_synchronize();
+  page->seq = 2;
+  return page;
+}
+
+const struct metrics_page *metrics_attach(const char *path) {
+  struct stat st;
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+  if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(metrics_page)) {
+    close(fd);
+    errno = EINVAL;
+    return NULL;
+  }
+  void *p = mmap(NULL, page_size(), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) {
+    return NULL;
+  }
+  const struct metrics_page *page = (const struct metrics_page *)p;
+  if (page->magic != METRICS_MAGIC || page->version != METRICS_VERSION) {
+    munmap(p, page_size());
+    errno = EINVAL;
+    return NULL;
+  }
+  return page;
+}
+
+void metrics_publish(struct metrics_page *page,
+                     const struct metrics_page *m) {
+  page->seq++;
+  __sync_synchronize();
+  memcpy((char *)page + BODY_OFFSET, (const char *)m + BODY_OFFSET, BODY_SIZE);
+  __sync_synchronize();
+  page->seq++;
+}
+
+void metrics_read(const struct metrics_page *page, struct metrics_page *out) {
+  for (;;) {
+    uint32_t before = page->seq;
+    __sync_synchronize();
+    memcpy(out, (const void *)page, sizeof(*out));
+    __sync_synchronize();
+    if (before % 2 == 0 && page->seq == before) {
+      return;
+    }
+    usleep(100);
+  }
+}
+
+void metrics_close(const struct metrics_page *page) {
+  munmap((void *)page, page_size());
+}
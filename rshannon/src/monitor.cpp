@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#include "../include/metrics.h"
+
+/*
+ * Live view of a running simulation.
+ *
+ * Watches the metrics file an emulator run started with -M writes (see
+ * metrics.h), printing one line per interval until the run finishes:
+ *
+ *   rdt -P gbn -m 100000000 ... -M /tmp/run.metrics &
+ *   monitor /tmp/run.metrics
+ *
+ * -1 prints a single line and exits, for scripts. Forked continuations
+ * (-F) publish to the file name followed by .1, .2 and so on.
+ */
+
+static void usage(char *filename) {
+  fprintf(stderr, "Usage:\n %s [-i Seconds between lines] [-1] metrics-file\n",
+          filename);
+}
+
+static void print_header() {
+  printf("%10s %12s %6s %12s %8s %8s %12s %9s %9s %10s %10s\n", "wall(s)",
+         "sim time", "done%", "msgs", "evlist", "max", "events/s", "retx",
+         "inflight", "thruput", "recent");
+}
+
+static void print_line(const struct metrics_page *m) {
+  printf("%10.1f %12.1f %6.2f %12d %8d %8d %12.0f %9d %9d %10.6f %10.6f%s\n",
+         m->wall_time, m->sim_time,
+         m->nsimmax > 0 ? 100.0 * m->nsim / m->nsimmax : 0.0, m->nsim,
+         m->evlist, m->evlist_max, m->events_per_sec, m->retransmissions,
+         m->inflight, m->throughput, m->recent_throughput,
+         m->blocked ? " blocked" : "");
+  fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+  double interval = 1.0;
+  bool once = false;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "i:1")) != -1) {
+    switch (opt) {
+    case 'i': interval = atof(optarg); break;
+    case '1': once = true; break;
+    default: usage(argv[0]); return -1;
+    }
+  }
+  if (optind != argc - 1 || interval <= 0.0) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  const struct metrics_page *page = metrics_attach(argv[optind]);
+  if (page == NULL) {
+    if (errno == EINVAL) {
+      fprintf(stderr, "%s: not a metrics file\n", argv[optind]);
+    } else {
+      perror(argv[optind]);
+    }
+    return -1;
+  }
+
+  struct metrics_page m;
+  metrics_read(page, &m);
+  printf("%s, pid %d\n", m.protocol, m.pid);
+  print_header();
+  for (;;) {
+    metrics_read(page, &m);
+    print_line(&m);
+    if (once || m.done) {
+      break;
+    }
+    if (kill(m.pid, 0) < 0 && errno == ESRCH) {
+      fprintf(stderr, "process %d exited before finishing the run\n", m.pid);
+      metrics_close(page);
+      return -1;
+    }
+    usleep((useconds_t)(interval * 1e6));
+  }
+  metrics_close(page);
+  return 0;
+}
@@ -0,0 +1,33 @@
+#include <string.h>
+
+#include "../include/protocol.h"
+
+#define PROTOCOL_HANDLE(ns, arg)                                              \
+  {#ns, ns::A_output, ns::A_input, ns::A_timerinterrupt,                      \
+   ns::A_init, ns::B_input, ns::B_init, ns::backlog,                          \
+   ns::save_state, ns::load_state, ns::reconfigure},
+
+static const struct protocol protocols[] = {PROTOCOLS(PROTOCOL_HANDLE, )};
+#define NPROTOCOLS (sizeof(protocols) / sizeof(protocols[0]))
+
+const struct protocol *find_protocol(const char *name) {
+  for (size_t i = 0; i < NPROTOCOLS; i++) {
+    if (strcmp(protocols[i].name, name) == 0) {
+      return &protocols[i];
+    }
+  }
+  return NULL;
+}
+
+const struct protocol *default_protocol(const char *program) {
+  const char *base = strrchr(program, '/');
+  base = base ? base + 1 : program;
+  for (size_t i = 0; i < NPROTOCOLS; i++) {
+    size_t len = strlen(protocols[i].name);
+    if (strncmp(base, protocols[i].name, len) == 0 &&
+        (base[len] == '\0' || base[len] == '_')) {
+      return &protocols[i];
+    }
+  }
+  return NULL;
+}
@@ -0,0 +1,276 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <ctype.h>
+#include <time.h>
+
+#include "../include/realtime.h"
+
+/* Statistics */
+int A_application = 0;
+int A_transport = 0;
+int B_application = 0;
+int B_transport = 0;
+
+struct rt_config rtcfg = {
+    1,     // seed
+    10,    // win_size
+    1000,  // nsimmax
+    0.0,   // lossprob
+    0.0,   // corruptprob
+    50.0,  // lambda
+    0,     // trace
+    100.0, // time_unit (us)
+    0.0,   // grace
+    NULL   // proto
+};
+
+static uint64_t start_ns;  // monotonic time at rt_start()
+static uint64_t end_ns;    // monotonic time at rt_report()
+
+static uint64_t nlatency;  // number of latency samples
+static uint64_t latency_sum;
+static uint64_t latency_min;
+static uint64_t latency_max;
+
+static void usage(char *filename, const char *extra) {
+  fprintf(stderr,
+          "Usage:\n %s -s Seed -w Window size -m Number of messages to "
+          "simulate -l Loss -c Corruption -t Average time between messages "
+          "from sender's layer5 -v Tracing [-u Microseconds per time unit "
+          "-g Grace time units after last message -P Protocol (%s)]",
+          filename, PROTOCOL_NAMES);
+  if (extra[0] != '\0') {
+    fprintf(stderr, " [backend options: %s]", extra);
+  }
+  fprintf(stderr, "\n");
+}
+
+static int read_int(int opt, char *arg) {
+  for (char *p = arg; *p; p++) {
+    if (!isdigit(*p)) {
+      fprintf(stderr, "Invalid value for -%c\n", opt);
+      exit(-1);
+    }
+  }
+  return atoi(arg);
+}
+
+static float read_prob(int opt, char *arg) {
+  float val = atof(arg);
+  if (val < 0.0 || val > 1.0) {
+    fprintf(stderr, "Invalid value for -%c\n", opt);
+    exit(-1);
+  }
+  return val;
+}
+
+static float read_positive(int opt, char *arg) {
+  float val = atof(arg);
+  if (val <= 0.0) {
+    fprintf(stderr, "Invalid value for -%c\n", opt);
+    exit(-1);
+  }
+  return val;
+}
+
+void rt_parse_args(int argc, char **argv, const char *extra,
+                   void (*handler)(int opt, char *arg)) {
+  char spec[64];
+  int opt;
+
+  snprintf(spec, sizeof(spec), "s:w:m:l:c:t:v:u:g:P:%s", extra);
+  while ((opt = getopt(argc, argv, spec)) != -1) {
+    switch (opt) {
+    case 's': rtcfg.seed = read_int(opt, optarg); break;
+    case 'w': rtcfg.win_size = read_int(opt, optarg); break;
+    case 'm': rtcfg.nsimmax = read_int(opt, optarg); break;
+    case 'l': rtcfg.lossprob = read_prob(opt, optarg); break;
+    case 'c': rtcfg.corruptprob = read_prob(opt, optarg); break;
+    case 't': rtcfg.lambda = read_positive(opt, optarg); break;
+    case 'v': rtcfg.trace = read_int(opt, optarg); break;
+    case 'u': rtcfg.time_unit = read_positive(opt, optarg); break;
+    case 'g':
+      if ((rtcfg.grace = atof(optarg)) < 0.0) {
+        fprintf(stderr, "Invalid value for -%c\n", opt);
+        exit(-1);
+      }
+      break;
+    case 'P':
+      if ((rtcfg.proto = find_protocol(optarg)) == NULL) {
+        fprintf(stderr, "Unknown protocol, use -P %s\n", PROTOCOL_NAMES);
+        exit(-1);
+      }
+      break;
+    case '?':
+      usage(argv[0], extra);
+      exit(-1);
+    default:
+      if (handler == NULL) {
+        usage(argv[0], extra);
+        exit(-1);
+      }
+      handler(opt, optarg);
+    }
+  }
+  // Without -P, ./gbn_udp and the like run the protocol they are named after
+  if (rtcfg.proto == NULL) {
+    rtcfg.proto = default_protocol(argv[0]);
+  }
+  if (rtcfg.proto == NULL) {
+    fprintf(stderr, "No protocol given, use -P %s\n", PROTOCOL_NAMES);
+    usage(argv[0], extra);
+    exit(-1);
+  }
+}
+
+uint64_t rt_now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void rt_start() {
+  start_ns = rt_now_ns();
+  latency_min = UINT64_MAX;
+}
+
+uint64_t rt_units_to_ns(float units) {
+  return (uint64_t)(units * rtcfg.time_unit * 1000.0);
+}
+
+float rt_ns_to_units(uint64_t ns) {
+  return (float)(ns / (rtcfg.time_unit * 1000.0));
+}
+
+float rt_rand(unsigned int *state) {
+  return rand_r(state) / (float)RAND_MAX;
+}
+
+/**
+ * Same model as the emulator's tolayer3: a packet is lost with
+ * probability lossprob, otherwise corrupted with probability corruptprob
+ * in one of its payload, seqnum or acknum fields.
+ */
+bool rt_impair(struct pkt *packet, unsigned int *state) {
+  float x;
+
+  if (rt_rand(state) < rtcfg.lossprob) {
+    if (rtcfg.trace > 0) {
+      printf("          TOLAYER3: packet being lost\n");
+    }
+    return false;
+  }
+  if (rt_rand(state) < rtcfg.corruptprob) {
+    if ((x = rt_rand(state)) < .75) {
+      packet->payload[0] = 'Z';
+    } else if (x < .875) {
+      packet->seqnum = 999999;
+    } else {
+      packet->acknum = 999999;
+    }
+    if (rtcfg.trace > 0) {
+      printf("          TOLAYER3: packet being corrupted\n");
+    }
+  }
+  return true;
+}
+
+float rt_next_gap(unsigned int *state) {
+  return rtcfg.lambda * rt_rand(state) * 2;
+}
+
+void rt_make_msg(int n, struct msg *message) {
+  memset(message->data, 97 + n % 26, sizeof(message->data));
+}
+
+void rt_record_latency(uint64_t ns) {
+  nlatency++;
+  latency_sum += ns;
+  if (ns < latency_min) {
+    latency_min = ns;
+  }
+  if (ns > latency_max) {
+    latency_max = ns;
+  }
+}
+
+void rt_latency_get(struct rt_latency *latency) {
+  latency->count = nlatency;
+  latency->sum = latency_sum;
+  latency->min = latency_min;
+  latency->max = latency_max;
+}
+
+void rt_latency_merge(const struct rt_latency *latency) {
+  nlatency += latency->count;
+  latency_sum += latency->sum;
+  if (latency->count > 0 && latency->min < latency_min) {
+    latency_min = latency->min;
+  }
+  if (latency->max > latency_max) {
+    latency_max = latency->max;
+  }
+}
+
+void rt_report(const char *name) {
+  end_ns = rt_now_ns();
+  float time_local = rt_ns_to_units(end_ns - start_ns);
+  double wall = (end_ns - start_ns) / 1e9;
+
+  printf(" %s runtime terminated at time %f\n after sending %d msgs from "
+         "layer5\n",
+         name, time_local, A_application);
+  printf("\n");
+  printf("[PA2]%d packets sent from the Application Layer of Sender A[/PA2]\n",
+         A_application);
+  printf("[PA2]%d packets sent from the Transport Layer of Sender A[/PA2]\n",
+         A_transport);
+  printf("[PA2]%d packets received at the Transport layer of Receiver "
+         "B[/PA2]\n",
+         B_transport);
+  printf("[PA2]%d packets received at the Application layer of Receiver "
+         "B[/PA2]\n",
+         B_application);
+  printf("[PA2]Total time: %f time units[/PA2]\n", time_local);
+  printf("[PA2]Throughput: %f packets/time units[/PA2]\n",
+         B_application / time_local);
+  printf("\n");
+  printf(" Wall clock: %f s (%f us per time unit)\n", wall, rtcfg.time_unit);
+  printf(" Messages/sec delivered to B: %f\n", B_application / wall);
+  if (nlatency > 0) {
+    printf(" Per-packet latency: mean %f us, min %f us, max %f us over %llu "
+           "packets\n",
+           latency_sum / 1000.0 / nlatency, latency_min / 1000.0,
+           latency_max / 1000.0, (unsigned long long)nlatency);
+  }
+}
+
+int getwinsize() { return rtcfg.win_size; }
+
+// The application here runs on the wall clock and cannot be held back, so
+// there is no send buffer limit and refused messages are lost.
+int getbufsize() { return 0; }
+
+// FEC is an emulator experiment (-f); the runtimes run without it.
+int getfecblock() { return 0; }
+
+int getfecparity() { return 0; }
+
+// So is pacing (-g); the runtimes send as soon as the window allows.
+int getpacing() { return 0; }
+
+// B's application reads every message as soon as it is delivered.
+int getunread() { return 0; }
+
+float get_sim_time() { return rt_ns_to_units(rt_now_ns() - start_ns); }
+
+void tolayer5(int AorB, char *datasent) {
+  if (rtcfg.trace > 2) {
+    printf("          TOLAYER5: data received: %.20s\n", datasent);
+  }
+  if (AorB == 1) {
+    B_application += 1;
+  }
+}
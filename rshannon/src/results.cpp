@@ -0,0 +1,260 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/file.h>
+
+#include "../include/results.h"
+
+#define ROWS_PER_GROUP 4096 // Rows buffered before an automatic flush
+
+/**
+ * Where each column lives in a result_row.
+ */
+struct column_spec {
+  const char *name;
+  int type;
+  size_t offset;
+};
+
+static const column_spec schema[] = {
+    {"protocol", COL_STR8, offsetof(result_row, protocol)},
+    {"seed", COL_I32, offsetof(result_row, seed)},
+    {"window", COL_I32, offsetof(result_row, window)},
+    {"messages", COL_I32, offsetof(result_row, messages)},
+    {"loss", COL_F64, offsetof(result_row, loss)},
+    {"corrupt", COL_F64, offsetof(result_row, corrupt)},
+    {"lambda", COL_F64, offsetof(result_row, lambda)},
+    {"A_application", COL_I32, offsetof(result_row, A_application)},
+    {"A_transport", COL_I32, offsetof(result_row, A_transport)},
+    {"B_transport", COL_I32, offsetof(result_row, B_transport)},
+    {"B_application", COL_I32, offsetof(result_row, B_application)},
+    {"retransmissions", COL_I32, offsetof(result_row, retransmissions)},
+    {"total_time", COL_F64, offsetof(result_row, total_time)},
+    {"throughput", COL_F64, offsetof(result_row, throughput)},
+    {"goodput", COL_F64, offsetof(result_row, goodput)},
+    {"duplicates", COL_I32, offsetof(result_row, duplicates)},
+    {"out_of_order", COL_I32, offsetof(result_row, out_of_order)},
+    {"unmatched", COL_I32, offsetof(result_row, unmatched)},
+    {"skipped", COL_I32, offsetof(result_row, skipped)},
+    {"delay_mean", COL_F64, offsetof(result_row, delay_mean)},
+    {"delay_p50", COL_F64, offsetof(result_row, delay_p50)},
+    {"delay_p99", COL_F64, offsetof(result_row, delay_p99)},
+    {"delay_p999", COL_F64, offsetof(result_row, delay_p999)},
+    {"delay_max", COL_F64, offsetof(result_row, delay_max)},
+    {"buffer_limit", COL_I32, offsetof(result_row, buffer_limit)},
+    {"buffer_max", COL_I32, offsetof(result_row, buffer_max)},
+    {"buffer_mean", COL_F64, offsetof(result_row, buffer_mean)},
+    {"blocked_time", COL_F64, offsetof(result_row, blocked_time)},
+    {"refused", COL_I32, offsetof(result_row, refused)},
+    {"fec_block", COL_I32, offsetof(result_row, fec_block)},
+    {"fec_parity", COL_I32, offsetof(result_row, fec_parity)},
+    {"fec_parity_sent", COL_I32, offsetof(result_row, fec_parity_sent)},
+    {"fec_recovered", COL_I32, offsetof(result_row, fec_recovered)},
+    {"pacing", COL_I32, offsetof(result_row, pacing)},
+    {"burst_max", COL_I32, offsetof(result_row, burst_max)},
+    {"burst_mean", COL_F64, offsetof(result_row, burst_mean)},
+    {"read_time", COL_F64, offsetof(result_row, read_time)},
+    {"unread_max", COL_I32, offsetof(result_row, unread_max)},
+    {"hops", COL_I32, offsetof(result_row, hops)},
+    {"queue_drops", COL_I32, offsetof(result_row, queue_drops)},
+    {"events", COL_F64, offsetof(result_row, events)},
+    {"wall_time", COL_F64, offsetof(result_row, wall_time)},
+};
+#define NCOLUMNS (sizeof(schema) / sizeof(schema[0]))
+
+static size_t type_size(int type) {
+  switch (type) {
+  case COL_I32: return 4;
+  case COL_F64: return 8;
+  case COL_STR8: return 8;
+  }
+  return 0;
+}
+
+static void put(std::vector<char> &buf, const void *data, size_t len) {
+  buf.insert(buf.end(), (const char *)data, (const char *)data + len);
+}
+
+struct results_writer *results_open(const char *path) {
+  int fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+  if (fd < 0) {
+    return NULL;
+  }
+  results_writer *w = new results_writer;
+  w->fd = fd;
+  return w;
+}
+
+void results_append(struct results_writer *w, const struct result_row *row) {
+  w->rows.push_back(*row);
+  if (w->rows.size() >= ROWS_PER_GROUP) {
+    results_flush(w);
+  }
+}
+
+bool results_flush(struct results_writer *w) {
+  if (w->rows.empty()) {
+    return true;
+  }
+  std::vector<char> buf;
+  uint16_t version = RESULTS_VERSION, ncols = NCOLUMNS;
+  uint32_t nrows = w->rows.size();
+
+  put(buf, RESULTS_MAGIC, 4);
+  put(buf, &version, sizeof(version));
+  put(buf, &ncols, sizeof(ncols));
+  put(buf, &nrows, sizeof(nrows));
+  for (size_t c = 0; c < NCOLUMNS; c++) {
+    uint8_t type = schema[c].type, len = strlen(schema[c].name);
+    put(buf, &type, 1);
+    put(buf, &len, 1);
+    put(buf, schema[c].name, len);
+  }
+  for (size_t c = 0; c < NCOLUMNS; c++) {
+    size_t size = type_size(schema[c].type);
+    for (size_t i = 0; i < w->rows.size(); i++) {
+      put(buf, (const char *)&w->rows[i] + schema[c].offset, size);
+    }
+  }
+
+  // One locked write per group keeps concurrent appenders from
+  // interleaving.
+  bool ok = true;
+  flock(w->fd, LOCK_EX);
+  size_t done = 0;
+  while (done < buf.size()) {
+    ssize_t n = write(w->fd, &buf[done], buf.size() - done);
+    if (n <= 0) {
+      ok = false;
+      break;
+    }
+    done += n;
+  }
+  flock(w->fd, LOCK_UN);
+  w->rows.clear();
+  return ok;
+}
+
+bool results_close(struct results_writer *w) {
+  bool ok = results_flush(w);
+  close(w->fd);
+  delete w;
+  return ok;
+}
+
+struct results_reader *results_read_open(const char *path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+  results_reader *r = new results_reader;
+  r->fd = fd;
+  r->nrows = 0;
+  return r;
+}
+
+/**
+ * Read exactly len bytes.
+ *
+ * @return 1 on success, 0 at a clean end of file, -1 on a short read
+ */
+static int read_full(int fd, void *data, size_t len) {
+  size_t done = 0;
+  while (done < len) {
+    ssize_t n = read(fd, (char *)data + done, len - done);
+    if (n < 0) {
+      return -1;
+    }
+    if (n == 0) {
+      return done == 0 ? 0 : -1;
+    }
+    done += n;
+  }
+  return 1;
+}
+
+int results_next_group(struct results_reader *r) {
+  char magic[4];
+  uint16_t version, ncols;
+  int status;
+
+  r->columns.clear();
+  r->nrows = 0;
+  if ((status = read_full(r->fd, magic, 4)) <= 0) {
+    return status;
+  }
+  if (memcmp(magic, RESULTS_MAGIC, 4) != 0 ||
+      read_full(r->fd, &version, 2) <= 0 || version != RESULTS_VERSION ||
+      read_full(r->fd, &ncols, 2) <= 0 ||
+      read_full(r->fd, &r->nrows, 4) <= 0) {
+    return -1;
+  }
+  r->columns.resize(ncols);
+  for (int c = 0; c < ncols; c++) {
+    uint8_t type, len;
+    if (read_full(r->fd, &type, 1) <= 0 || read_full(r->fd, &len, 1) <= 0 ||
+        type_size(type) == 0) {
+      return -1;
+    }
+    r->columns[c].type = type;
+    if (len > 0 && read_full(r->fd, r->columns[c].name, len) <= 0) {
+      return -1;
+    }
+    r->columns[c].name[len] = '\0';
+  }
+  for (int c = 0; c < ncols; c++) {
+    r->columns[c].data.resize(type_size(r->columns[c].type) * r->nrows);
+    if (r->nrows > 0 &&
+        read_full(r->fd, &r->columns[c].data[0], r->columns[c].data.size()) <=
+            0) {
+      return -1;
+    }
+  }
+  return 1;
+}
+
+static const results_column *find_column(const struct results_reader *r,
+                                         const char *name, int type) {
+  for (size_t c = 0; c < r->columns.size(); c++) {
+    if (r->columns[c].type == type && strcmp(r->columns[c].name, name) == 0) {
+      return &r->columns[c];
+    }
+  }
+  return NULL;
+}
+
+const int32_t *results_i32(const struct results_reader *r, const char *name) {
+  const results_column *col = find_column(r, name, COL_I32);
+  return col && r->nrows > 0 ? (const int32_t *)&col->data[0] : NULL;
+}
+
+const double *results_f64(const struct results_reader *r, const char *name) {
+  const results_column *col = find_column(r, name, COL_F64);
+  return col && r->nrows > 0 ? (const double *)&col->data[0] : NULL;
+}
+
+const char *results_str8(const struct results_reader *r, const char *name) {
+  const results_column *col = find_column(r, name, COL_STR8);
+  return col && r->nrows > 0 ? &col->data[0] : NULL;
+}
+
+void results_row(const struct results_reader *r, uint32_t i,
+                 struct result_row *row) {
+  memset(row, 0, sizeof(*row));
+  for (size_t c = 0; c < NCOLUMNS; c++) {
+    const results_column *col = find_column(r, schema[c].name, schema[c].type);
+    if (col == NULL) {
+      continue;
+    }
+    size_t size = type_size(schema[c].type);
+    memcpy((char *)row + schema[c].offset, &col->data[i * size], size);
+  }
+}
+
+void results_read_close(struct results_reader *r) {
+  close(r->fd);
+  delete r;
+}
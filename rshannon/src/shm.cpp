@@ -0,0 +1,236 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "../include/realtime.h"
+#include "../include/spsc_ring.h"
+
+/*
+ * Shared-memory runtime.
+ *
+ * Entity A runs in the parent process and entity B in a forked child. The
+ * two are connected by a pair of lock-free single-producer/single-consumer
+ * rings in an anonymous shared mapping, one per direction, so no packet
+ * crosses the kernel. Each process polls its inbound ring, its own timer
+ * deadline and (for A) the layer 5 arrival schedule on the monotonic
+ * clock. Loss and corruption are optional and follow the emulator's -l/-c
+ * model.
+ *
+ * By default an idle loop iteration yields the CPU so the runtime behaves
+ * on machines with fewer free cores than processes; -b busy-polls instead,
+ * which is the configuration to use for maximum message rate.
+ */
+
+#define A 0
+#define B 1
+
+#define RING_SIZE 4096 // Packets in flight per direction
+
+/**
+ * A ring slot: the protocol's packet and its monotonic send time.
+ */
+struct shm_slot {
+  uint64_t sent_ns;
+  struct pkt packet;
+};
+
+/**
+ * Layout of the shared segment.
+ */
+struct shm_segment {
+  spsc_ring<shm_slot, RING_SIZE> ring[2]; // ring[e] carries packets to e
+  std::atomic<int> done;                  // Set by A when the run is over
+  int B_transport;                        // Reported back by B on exit
+  int B_application;
+  int nfull;                              // Packets B found its ring full for
+  struct rt_latency latency;              // Latency measured at B
+};
+
+static struct shm_segment *seg;
+static int self;                 // Entity run by this process
+static bool timer_running;       // Whether this entity's timer is armed
+static uint64_t timer_deadline;  // When it fires
+static unsigned int rng;         // Impairment and arrival random state
+static bool busy_poll = false;   // -b: never yield when idle
+
+static int nsim = 0;             // Messages handed to A so far
+static int nlost = 0;            // Packets dropped by impairment
+static int nfull = 0;            // Packets dropped because the ring was full
+
+static void handle_opt(int opt, char *arg) {
+  if (opt == 'b') {
+    busy_poll = true;
+  }
+}
+
+/**
+ * Deliver everything waiting on this entity's inbound ring.
+ *
+ * @return the number of packets delivered
+ */
+static int receive() {
+  spsc_ring<shm_slot, RING_SIZE> *ring = &seg->ring[self];
+  struct shm_slot *slot;
+  int n = 0;
+
+  while ((slot = ring->front()) != NULL) {
+    struct pkt packet = slot->packet;
+    rt_record_latency(rt_now_ns() - slot->sent_ns);
+    ring->pop();
+    if (self == A) {
+      rtcfg.proto->A_input(packet);
+    } else {
+      B_transport += 1;
+      rtcfg.proto->B_input(packet);
+    }
+    n++;
+  }
+  return n;
+}
+
+/**
+ * Fire this entity's timer if its deadline has passed.
+ */
+static int expire(uint64_t now) {
+  if (!timer_running || now < timer_deadline) {
+    return 0;
+  }
+  timer_running = false;
+  if (self == A) {
+    rtcfg.proto->A_timerinterrupt();
+  }
+  return 1;
+}
+
+static void run_B() {
+  rtcfg.proto->B_init();
+  while (!seg->done.load(std::memory_order_acquire)) {
+    int work = receive() + expire(rt_now_ns());
+    if (work == 0 && !busy_poll) {
+      sched_yield();
+    }
+  }
+  seg->B_transport = B_transport;
+  seg->B_application = B_application;
+  seg->nfull = nfull;
+  rt_latency_get(&seg->latency);
+}
+
+static void run_A() {
+  struct msg message;
+  uint64_t next_arrival, deadline = 0;
+
+  rtcfg.proto->A_init();
+  next_arrival = rt_now_ns() + rt_units_to_ns(rt_next_gap(&rng));
+  while (1) {
+    uint64_t now = rt_now_ns();
+    int work = receive() + expire(now);
+    while (nsim < rtcfg.nsimmax && next_arrival <= now) {
+      rt_make_msg(nsim, &message);
+      nsim++;
+      A_application += 1;
+      rtcfg.proto->A_output(message);
+      next_arrival += rt_units_to_ns(rt_next_gap(&rng));
+      work++;
+    }
+    if (nsim == rtcfg.nsimmax) {
+      if (rtcfg.grace <= 0.0) {
+        break; // all done, as in the emulator
+      }
+      if (deadline == 0) {
+        deadline = now + rt_units_to_ns(rtcfg.grace);
+      } else if (now >= deadline) {
+        break;
+      }
+    }
+    if (work == 0 && !busy_poll) {
+      sched_yield();
+    }
+  }
+  seg->done.store(1, std::memory_order_release);
+}
+
+int main(int argc, char **argv) {
+  pid_t child;
+  int status;
+
+  rt_parse_args(argc, argv, "b", handle_opt);
+
+  seg = (struct shm_segment *)mmap(NULL, sizeof(struct shm_segment),
+                                   PROT_READ | PROT_WRITE,
+                                   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (seg == MAP_FAILED) {
+    perror("mmap");
+    return -1;
+  }
+  seg->ring[A].init();
+  seg->ring[B].init();
+  seg->done.store(0);
+
+  fflush(stdout);
+  rt_start();
+  if ((child = fork()) < 0) {
+    perror("fork");
+    return -1;
+  }
+  if (child == 0) {
+    self = B;
+    rng = rtcfg.seed + 1;
+    run_B();
+    fflush(stdout);
+    _exit(0);
+  }
+  self = A;
+  rng = rtcfg.seed;
+  run_A();
+  waitpid(child, &status, 0);
+
+  B_transport = seg->B_transport;
+  B_application = seg->B_application;
+  rt_latency_merge(&seg->latency);
+  rt_report("Shared memory");
+  printf(" Ring drops: %d full at A->B, %d full at B->A; %d lost to "
+         "impairment at A\n",
+         nfull, seg->nfull, nlost);
+  return 0;
+}
+
+/********************** Student-callable ROUTINES ***********************/
+
+void starttimer(int AorB, float increment) {
+  if (timer_running) {
+    printf("Warning: attempt to start a timer that is already started\n");
+    return;
+  }
+  timer_deadline = rt_now_ns() + rt_units_to_ns(increment);
+  timer_running = true;
+}
+
+void stoptimer(int AorB) {
+  if (!timer_running) {
+    printf("Warning: unable to cancel your timer. It wasn't running.\n");
+    return;
+  }
+  timer_running = false;
+}
+
+void tolayer3(int AorB, struct pkt packet) {
+  struct shm_slot slot;
+
+  if (AorB == A) {
+    A_transport += 1;
+  }
+  if (!rt_impair(&packet, &rng)) {
+    nlost++;
+    return;
+  }
+  slot.sent_ns = rt_now_ns();
+  slot.packet = packet;
+  if (!seg->ring[(AorB + 1) % 2].push(slot)) {
+    nfull++;
+  }
+}
@@ -2,8 +2,27 @@
 #include <stdlib.h>
 #include <getopt.h>
 #include <ctype.h>
+#include <errno.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <pthread.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
 
 #include "../include/simulator.h"
+#include "../include/protocol.h"
+#include "../include/event.h"
+#include "../include/stats.h"
+#include "../include/results.h"
+#include "../include/checkpoint.h"
+#include "../include/fec.h"
+#include "../include/metrics.h"
+#include "../include/topology.h"
+#include "../include/workload.h"
 
 /* Statistics */
 int A_application = 0;
@@ -16,24 +35,296 @@ int win_size;
 int TRACE = 1;             /* for my debugging */
 int nsim = 0;              /* number of messages from 5 to 4 so far */
 int nsimmax = 0;           /* number of msgs to generate, then stop */
-float time_local = 0;
+thread_local float time_local = 0; /* the clock, per LP with -j (see below) */
 float lossprob;            /* probability that a packet is dropped  */
 float corruptprob;         /* probability that one bit is packet is flipped */
 float lambda;              /* arrival rate of messages from layer 5 */
-int   ntolayer3;           /* number sent into layer 3 */
-int   nlost;               /* number lost in media */
-int ncorrupt;              /* number corrupted by media*/
+thread_local int ntolayer3;/* number sent into layer 3 */
+thread_local int nlost;    /* number lost in media */
+thread_local int ncorrupt; /* number corrupted by media*/
+
+/* Reordering channel. When reorderprob is zero the medium is FIFO, as in the */
+/* original emulator. Otherwise each packet is, with probability reorderprob, */
+/* held back by an extra displacement delay drawn from reorderdist, letting  */
+/* packets sent after it overtake it.                                        */
+#define  DISP_UNIFORM    0    /* displacement uniform on [0,2*reorderdisp]   */
+#define  DISP_EXP        1    /* displacement exponential, mean reorderdisp  */
+float reorderprob = 0.0;   /* probability that a packet is displaced */
+float reorderdisp = 10.0;  /* mean displacement of a reordered packet */
+int   reorderdist = DISP_UNIFORM;
+thread_local int nreordered; /* number displaced by media */
+float lastarrival[2];      /* latest in-order arrival scheduled per entity */
+int   nsent3[2];           /* packets handed to the medium, per destination */
+int   maxarrived3[2];      /* highest send index delivered, per destination */
+int   noutoforder[2];      /* deliveries overtaken by a later send */
+
+/* Per-message delay and time-series sampling. Every message handed to A  */
+/* is timestamped and matched at B's layer 5, and its end-to-end delay    */
+/* goes into a log-bucketed histogram. Messages handed over before warmup */
+/* are left out of the histogram and the steady-state throughput.         */
+float warmup = 0.0;        /* time units excluded from delay statistics */
+float sampleint = 0.0;     /* time units between samples, 0 for none */
+float nextsample;          /* time of the next time-series sample */
+struct histogram delayhist;/* end-to-end message delay */
+thread_local int ninflight;/* packets currently in the medium */
+int   nretransmit;         /* packets A sent for a message more than once */
+int   nunmatched;          /* layer 5 deliveries matching no message */
+
+/* Delivery validation. Each delivery at B's layer 5 is also checked    */
+/* against what A's application handed over (see stats.h): B_application */
+/* counts every delivery, ngoodput only messages delivered intact and in  */
+/* order, the first time.                                                 */
+int   ngoodput;            /* deliveries intact and in order */
+int   nduplicate;          /* deliveries of a message delivered before */
+int   nlate;               /* deliveries of a message skipped before */
+int   ngaps;               /* deliveries that skipped messages */
+int   nskipped;            /* messages they skipped */
+int   B_steady;            /* deliveries at B after warmup */
+int   lastsampleB;         /* B_application at the previous sample */
+int   lastsampleretx;      /* nretransmit at the previous sample */
+
+char *resultspath = NULL;  /* binary results file to append a row to */
+
+/* Message arrivals. The next arrival is kept out of the event list and   */
+/* merged with it by the event loop, so handing a message over costs no   */
+/* list insert. The original uniform gaps are drawn one per arrival with  */
+/* jimsrand(), keeping runs identical to the original emulator; the other */
+/* processes draw ARRIVAL_BATCH gaps at a time from a stream of their own */
+/* (so they leave the channel's random numbers alone), in units of lambda */
+/* so a -F t= variant rescales the gaps already drawn. A replayed         */
+/* workload (-A) takes its gaps, and its payloads, from the mapped file.  */
+#define  ARRIVE_UNIFORM  0    /* gaps uniform on [0,2*lambda]                */
+#define  ARRIVE_EXP      1    /* Poisson arrivals: exponential gaps          */
+#define  ARRIVE_CBR      2    /* constant bit rate: a gap of exactly lambda  */
+#define  ARRIVE_ONOFF    3    /* Pareto on-off: bursts separated by silences */
+#define  ARRIVE_REPLAY   4    /* the recorded gaps of a workload file        */
+#define  ARRIVAL_BATCH   1024 /* gaps drawn at a time                        */
+#define  ONOFF_SHAPE     1.5  /* Pareto shape of burst lengths and silences  */
+#define  ONOFF_PEAK      10.0 /* rate within a burst, in multiples of 1/lambda */
+int   arrivaldist = ARRIVE_UNIFORM;
+float burstlen = 10.0;     /* mean messages per on-off burst */
+struct event arrival = { 0.0, FROM_LAYER5 }; /* the next arrival */
+#define  ARRIVAL         (EVNIL - 1) /* its index, to nextevent() */
+unsigned short arrivalrng[3]; /* erand48() state of the arrival stream */
+float arrivalgaps[ARRIVAL_BATCH]; /* gaps drawn ahead, in units of lambda */
+int   nextgap;             /* next unused gap, ARRIVAL_BATCH for none */
+int   burstleft;           /* messages left in the current on-off burst */
+char  *workloadpath = NULL; /* workload file to replay (-A) */
+struct workload workload;  /* it, mapped */
+uint64_t replaynext;       /* next record whose gap is to be drawn */
+
+/* Application backpressure. With a send buffer of bufsize messages (-q) */
+/* A_output refuses a message once A holds that many, and the            */
+/* application blocks with the message in hand: the next arrival is put  */
+/* off until A takes the message on a later event, and then comes the    */
+/* gap already drawn for it later. Without -q a refused message is lost. */
+/* Either way A's buffer occupancy (its backlog()) is tracked over time. */
+#define  NEVER           1.0e30 /* arrival time while blocked */
+int   bufsize = 0;         /* messages A may hold, 0 for no limit */
+int   blocked;             /* the application is waiting on A */
+struct msg heldmsg;        /* the message it is waiting to hand over */
+float blockedsince;        /* when it blocked */
+float blockedgap;          /* gap to the arrival after the held message */
+float blockedtime;         /* time spent blocked, up to the last resume */
+int   nblocked;            /* times the application blocked */
+int   nrefused;            /* messages refused by A and lost (no -q) */
+int   occupancy;           /* messages A held after the last event */
+int   maxoccupancy;        /* most messages A held at once */
+double occupancyarea;      /* occupancy integrated over time */
+
+/* Forward error correction. With -f k:r GBN and SR follow every k data   */
+/* packets with r parity packets, from which B rebuilds up to r losses    */
+/* per block (see fec.h). The counters live with the codec, in fec.cpp.   */
+int   fecblock = 0;        /* data packets per block, 0 for no FEC */
+int   fecparity = 1;       /* parity packets per block */
+
+/* Pacing. With -g b GBN spaces A's packets over each round trip instead  */
+/* of sending them as soon as the window allows, at most b back to back   */
+/* (see gbn.h). Either way A's bursts are measured: packets it hands to   */
+/* layer 3 at the same instant of simulated time form one burst.          */
+int   pacing = 0;          /* burst A's pacer allows, 0 for no pacing */
+float bursttime = -1.0;    /* when the latest burst was sent */
+int   burstlen_now;        /* packets in it so far */
+int   nbursts;             /* bursts A sent */
+int   maxburst;            /* largest of them */
+
+/* B's application. By default it reads every message the moment it is   */
+/* delivered. With -C it reads them one at a time, each read taking a     */
+/* time uniform on [0,2*readtime] drawn from a stream of its own, so      */
+/* delivered messages can wait unread in B's receive buffer. getunread()  */
+/* tells the protocols how many do, for the window they advertise.        */
+float readtime = 0.0;      /* mean time B's application takes per message */
+unsigned short readrng[3]; /* erand48() state of the read times */
+int   nunread;             /* messages delivered to B but not yet read */
+float nextread;            /* when the oldest unread message will be read */
+int   maxunread;           /* most messages waiting unread at once */
+
+/* Multi-hop medium. With -T packets cross the links and routers of a  */
+/* topology read from a file instead of the single implicit hop, each  */
+/* link with its own delay, loss, corruption and queue (see            */
+/* topology.h), whose loss and corruption stand in for -l and -c. A    */
+/* packet waiting at a router is an AT_ROUTER event of the host it is  */
+/* headed for, forwarded on by hop().                                  */
+char *topopath = NULL;     /* topology file, NULL for the single hop */
+struct topology topo;
+
+/* Live metrics. With -M the event loop publishes its progress to a      */
+/* shared page in a file (see metrics.h) every METRICS_PERIOD seconds of */
+/* wall time, looking at the clock only every METRICS_CHECK events.      */
+#define METRICS_CHECK 4096
+char *metricspath = NULL;  /* file to publish live metrics to */
+struct metrics_page *metrics = NULL;
+thread_local int nevlist;  /* events in the event list */
+thread_local int maxevlist;/* longest the event list has been */
+thread_local unsigned long long nsimevents; /* events simulated */
+int   metricscountdown;    /* events until the next look at the clock */
+double metricsstart;       /* wall time the run started */
+double metricslast;        /* wall time of the last snapshot */
+unsigned long long metricslastevents; /* nsimevents at the last snapshot */
+float metricslasttime;     /* time_local at the last snapshot */
+int   metricslastB;        /* B_application at the last snapshot */
+
+/* Profiling. With -p every event, every call into the protocol and every */
+/* call the protocol makes into the emulator is timed with the CPU's      */
+/* cycle counter into a histogram of its own, and the counts, totals and  */
+/* distributions are printed at the end. Calls into the emulator are      */
+/* timed inside the callbacks that make them, so those totals overlap.    */
+enum { PROF_A_OUTPUT, PROF_A_INPUT, PROF_B_INPUT, PROF_A_TIMER,
+       PROF_EV_TIMER, PROF_EV_LAYER5, PROF_EV_LAYER3, /* in evtype order */
+       PROF_EV_ROUTER, PROF_INSERTEVENT, PROF_TOLAYER3, PROF_TOLAYER5,
+       PROF_STARTTIMER, PROF_STOPTIMER, NPROF };
+const char *profnames[NPROF] = {
+   "A_output", "A_input", "B_input", "A_timerinterrupt",
+   "timer event", "layer 5 event", "layer 3 event", "router event",
+   "insertevent", "tolayer3", "tolayer5", "starttimer", "stoptimer" };
+int   profiling = 0;
+struct histogram *profhist;/* NPROF histograms of cycles, with -p */
+double profwall;           /* wall time the event loop took, with or */
+unsigned long long profcycles; /* without -p, and the cycles it took */
+
+#if defined(__x86_64__) || defined(__i386__)
+#define cycles() __rdtsc()
+#else
+/* no cycle counter we can read from user space: count nanoseconds */
+unsigned long long cycles()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec*1000000000ULL + ts.tv_nsec;
+}
+#endif
+
+/* times the rest of the enclosing block into profhist[which] with -p. */
+/* It is inlined even in unoptimized builds, leaving a test of         */
+/* profiling behind when it is off.                                    */
+struct profscope {
+   int which;
+   unsigned long long start;
+   __attribute__((always_inline)) profscope(int w) : which(w) {
+      if (profiling)
+         start = cycles();
+      }
+   __attribute__((always_inline)) ~profscope() {
+      if (profiling)
+         hist_record(&profhist[which], (double)(cycles() - start));
+      }
+};
+#define PROFILE(which) struct profscope profscope_(which)
+
+/* Partitioned parallel run. With -j the event loop is split into one    */
+/* logical process (LP) per host, A and B, each with its own event list, */
+/* clock, counters and stream of channel random numbers for the packets  */
+/* it sends. A packet spends at least LOOKAHEAD time units in the medium, */
+/* so within a window [T,T+LOOKAHEAD) starting at the earliest pending   */
+/* event no LP can affect another: each runs its events due in the       */
+/* window, posting copies of the packets it sends to their destination,  */
+/* and they all meet at a barrier before the next window. A owns the     */
+/* message tracker, so B logs its deliveries and A matches them at the   */
+/* start of the next window. The globals both sides touch, the event     */
+/* arena among them, are thread_local, and a thread swaps in the LP it   */
+/* is running. -j 1 runs the same windows on one thread, so a run's      */
+/* results do not depend on the number of threads; they differ from the  */
+/* original loop's, which draws the whole channel from one stream.       */
+#define NLPS       2
+#define LOOKAHEAD  1.0    /* least time a packet spends in the medium */
+struct delivery {
+   float time;
+   char data[20];
+};
+struct lp {
+   int   entity;          /* A or B */
+   struct arena evarena;  /* its state while no thread is running it */
+   evidx evlist;
+   float time_local;
+   int   nevlist, maxevlist, ntolayer3, nlost, ncorrupt, nreordered;
+   int   ninflight;
+   unsigned long long nsimevents;
+   unsigned short rng[3]; /* erand48() state of its channel draws */
+   int   window;          /* window being run */
+   struct event *outbox[2][NLPS]; /* packets posted, by window parity */
+   int   nout[2][NLPS], maxout[2][NLPS]; /* and destination          */
+   float outmin[2];       /* earliest of them */
+   struct delivery *log[2]; /* deliveries at layer 5, by window parity */
+   int   nlog[2], maxlog[2];
+   float next[2];         /* earliest event it holds after the window */
+   int   done[2];         /* A found every message handed over, by */
+                          /* window parity                          */
+};
+int   nthreads = 0;        /* threads of a partitioned run, 0 for none */
+struct lp lps[NLPS];
+thread_local struct lp *curlp = NULL; /* LP this thread is running */
+pthread_barrier_t windowbarrier;
+float firstwindow;         /* when the first window starts */
+long  nwindows;            /* windows the partitioned run took */
+
+/* an LP's share of the thread-local globals, swapped in and out */
+#define LP_STATE(X) \
+   X(evarena) X(evlist) X(time_local) X(nevlist) X(maxevlist) X(ntolayer3) \
+   X(nlost) X(ncorrupt) X(nreordered) X(ninflight) X(nsimevents)
+
+/* Checkpoints and what-if forks. At the first event due at or after     */
+/* snapat the whole simulation state is written to ckptpath, and/or the  */
+/* process forks into one copy-on-write continuation per variant, each   */
+/* with its own loss, corruption, window or arrival rate. A run started  */
+/* with a restorepath picks up from a checkpoint instead of time 0.      */
+#define MAXVARIANTS 64
+float snapat = -1.0;       /* time to checkpoint or fork at, <0 for never */
+char *ckptpath = NULL;     /* checkpoint file to write at snapat */
+char *restorepath = NULL;  /* checkpoint file to start from */
+char *variants[MAXVARIANTS]; /* what-if continuations, e.g. "l=0.4,w=20" */
+int   nvariants = 0;
+char  rngstate[128];       /* random() state, so checkpoints can save it */
+
+/* emulator state in a checkpoint, in file order (the event list and */
+/* random number generator are saved separately)                     */
+#define CKPT_STATE(X) \
+   X(time_local) X(nsim) X(A_application) X(A_transport) X(B_application) \
+   X(B_transport) X(ntolayer3) X(nlost) X(ncorrupt) X(nreordered) \
+   X(lastarrival) X(nsent3) X(maxarrived3) X(noutoforder) X(nextsample) \
+   X(delayhist) X(ninflight) X(nretransmit) X(nunmatched) X(ngoodput) \
+   X(nduplicate) X(nlate) X(ngaps) X(nskipped) X(B_steady) \
+   X(lastsampleB) X(lastsampleretx) X(arrival.evtime) X(arrival.eventity) \
+   X(arrivalrng) X(arrivalgaps) X(nextgap) X(burstleft) X(replaynext) \
+   X(blocked) X(heldmsg) X(blockedsince) X(blockedgap) X(blockedtime) \
+   X(nblocked) X(nrefused) X(occupancy) X(maxoccupancy) X(occupancyarea) \
+   X(fec_parity_sent) X(fec_recovered) X(bursttime) X(burstlen_now) \
+   X(nbursts) X(maxburst) X(readrng) X(nunread) X(nextread) \
+   X(maxunread)
 
 /****************************************************************************/
 /* jimsrand(): return a float in range [0,1].  The routine below is used to */
 /* isolate all random number generation in one location.  We assume that the*/
 /* system-supplied rand() function return an int in therange [0,mmm]        */
+/* (random() is used: it is the same generator as rand() in glibc, and its  */
+/* state can be saved and restored with setstate() for checkpoints)        */
 /****************************************************************************/
 float jimsrand() 
 {
   double mmm = 2147483647;   /* largest int  - MACHINE DEPENDENT!!!!!!!!   */
   float x;                   /* individual students may need to change mmm */ 
-  x = rand()/mmm;            /* x should be uniform in [0,1] */
+  if (curlp != NULL)         /* an LP of a partitioned run: its own stream */
+     return erand48(curlp->rng);
+  x = random()/mmm;          /* x should be uniform in [0,1] */
   return(x);
 }  
 
@@ -56,63 +347,62 @@ to, and you defeinitely should not have to modify
 
 
 
-/* possible events: */
-#define  TIMER_INTERRUPT 0  
-#define  FROM_LAYER5     1
-#define  FROM_LAYER3     2
+/* event types and struct event live in event.h */
 
-#define  OFF             0
-#define  ON              1
-#define   A    0
-#define   B    1
+thread_local struct arena evarena = { NULL, 0, 0, EVNIL };
+thread_local evidx evlist = EVNIL; /* the event list */
 
+evidx newevent()
+{
+   evidx i;
 
-struct event {
-   float evtime;           /* event time */
-   int evtype;             /* event type code */
-   int eventity;           /* entity where event occurs */
-   struct pkt *pktptr;     /* ptr to packet (if any) assoc w/ this event */
-   struct event *prev;
-   struct event *next;
- };
-struct event *evlist = NULL;   /* the event list */
+   if (evarena.free != EVNIL) {
+      i = evarena.free;
+      evarena.free = eventat(i)->next;
+      return i;
+      }
+   if (evarena.top == evarena.size) {
+      evarena.size = evarena.size > 0 ? 2*evarena.size : ARENA_MIN;
+      evarena.events = (struct event *)realloc(evarena.events,
+                          evarena.size*sizeof(struct event));
+      if (evarena.events == NULL) {
+         perror("realloc");
+         exit(-1);
+         }
+      }
+   return evarena.top++;
+}
 
+void freeevent(evidx i)
+{
+   eventat(i)->next = evarena.free;
+   evarena.free = i;
+}
 
-void insertevent(struct event *p)
+void insertevent(evidx i)
 {
-   struct event *q,*qold;
+   struct event *p = eventat(i), *q;
+   evidx at, before;
+   PROFILE(PROF_INSERTEVENT);
 
    if (TRACE>2) {
       printf("            INSERTEVENT: time is %lf\n",time_local);
       printf("            INSERTEVENT: future time will be %lf\n",p->evtime); 
       }
-   q = evlist;     /* q points to header of list in which p struct inserted */
-   if (q==NULL) {   /* list is empty */
-        evlist=p;
-        p->next=NULL;
-        p->prev=NULL;
-        }
-     else {
-        for (qold = q; q !=NULL && p->evtime > q->evtime; q=q->next)
-              qold=q; 
-        if (q==NULL) {   /* end of list */
-             qold->next = p;
-             p->prev = qold;
-             p->next = NULL;
-             }
-           else if (q==evlist) { /* front of list */
-             p->next=evlist;
-             p->prev=NULL;
-             p->next->prev=p;
-             evlist = p;
-             }
-           else {     /* middle of list */
-             p->next=q;
-             p->prev=q->prev;
-             q->prev->next=p;
-             q->prev=p;
-             }
-         }
+   if (++nevlist > maxevlist)
+      maxevlist = nevlist;
+   /* p goes in front of the first event due no earlier */
+   for (before = EVNIL, at = evlist; at != EVNIL; before = at, at = q->next)
+      if (p->evtime <= (q = eventat(at))->evtime)
+         break;
+   p->prev = before;
+   p->next = at;
+   if (at != EVNIL)
+      eventat(at)->prev = i;
+   if (before != EVNIL)
+      eventat(before)->next = i;
+     else
+      evlist = i;
 }
 
 
@@ -123,28 +413,128 @@ void insertevent(struct event *p)
 /*  The next set of routines handle the event list   */
 /*****************************************************/
 
+/* a Pareto variate with mean m, from the arrival stream */
+double pareto(double m)
+{
+   return m*(ONOFF_SHAPE-1)/ONOFF_SHAPE *
+          pow(1.0 - erand48(arrivalrng), -1.0/ONOFF_SHAPE);
+}
+
+/* draw the next ARRIVAL_BATCH gaps of the arrival process, in units of */
+/* lambda. An on-off burst is a silence followed by its messages at     */
+/* ONOFF_PEAK times the mean rate; the silences are long enough to keep */
+/* the mean gap at lambda.                                              */
+void draw_arrival_gaps()
+{
+   int i;
+   double silence;
+
+   switch (arrivaldist) {
+     case ARRIVE_EXP:
+       for (i=0; i<ARRIVAL_BATCH; i++)
+          arrivalgaps[i] = -log(1.0 - erand48(arrivalrng));
+       break;
+     case ARRIVE_CBR:
+       for (i=0; i<ARRIVAL_BATCH; i++)
+          arrivalgaps[i] = 1.0;
+       break;
+     case ARRIVE_ONOFF:
+       silence = burstlen - (burstlen - 1)/ONOFF_PEAK;
+       for (i=0; i<ARRIVAL_BATCH; i++) {
+          if (burstleft > 0) {
+             burstleft--;
+             arrivalgaps[i] = 1.0/ONOFF_PEAK;
+             continue;
+             }
+          arrivalgaps[i] = pareto(silence);
+          burstleft = burstlen > 1.0 ? (int)(pareto(burstlen - 1) + 0.5) : 0;
+          }
+       break;
+     case ARRIVE_REPLAY:
+       for (i=0; i<ARRIVAL_BATCH; i++, replaynext++) {
+          if (replaynext >= workload.count) {
+             arrivalgaps[i] = 1.0;   /* past the last message: never used */
+             continue;
+             }
+          arrivalgaps[i] = workload.records[replaynext].time -
+             (replaynext > 0 ? workload.records[replaynext-1].time : 0.0);
+          if (arrivalgaps[i] < 0.0) {
+             fprintf(stderr, "%s: message %llu is earlier than the one "
+                     "before it\n", workloadpath, (unsigned long long)replaynext);
+             exit(-1);
+             }
+          }
+       break;
+     }
+   nextgap = 0;
+}
+
 void generate_next_arrival()
 {
-   double x,log(),ceil();
-   struct event *evptr;
-//    //char *malloc();
-   float ttime;
-   int tempint;
+   double x;
 
    if (TRACE>2)
        printf("          GENERATE NEXT ARRIVAL: creating new arrival\n");
 
-   x = lambda*jimsrand()*2;  /* x is uniform on [0,2*lambda] */
-                             /* having mean of lambda        */
+   if (arrivaldist == ARRIVE_UNIFORM)
+      x = lambda*jimsrand()*2;  /* x is uniform on [0,2*lambda] */
+                                /* having mean of lambda        */
+     else {
+      if (nextgap == ARRIVAL_BATCH)
+         draw_arrival_gaps();
+      x = lambda*arrivalgaps[nextgap++];
+      }
 
-   evptr = (struct event *)malloc(sizeof(struct event));
-   evptr->evtime =  time_local + x;
-   evptr->evtype =  FROM_LAYER5;
+   arrival.evtime =  time_local + x;
    if (BIDIRECTIONAL && (jimsrand()>0.5) )
-      evptr->eventity = B;
+      arrival.eventity = B;
     else
-      evptr->eventity = A;
-   insertevent(evptr);
+      arrival.eventity = A;
+}
+
+/* take the earliest event off the event list */
+evidx popevent()
+{
+   evidx i;
+
+   i = evlist;
+   nevlist--;
+   evlist = eventat(i)->next;    /* remove this event from event list */
+   if (evlist!=EVNIL)
+      eventat(evlist)->prev=EVNIL;
+   return i;
+}
+
+/* the time of the earliest event in the list, NEVER if it is empty */
+float earliest()
+{
+   return evlist != EVNIL ? eventat(evlist)->evtime : NEVER;
+}
+
+/* take the next event off the event list, or the next arrival if that */
+/* is due first. An arrival goes ahead of events due at the same time.  */
+evidx nextevent()
+{
+   if (arrival.evtime <= earliest())
+      return ARRIVAL;
+   return popevent();
+}
+
+/* the same for an LP of a partitioned run, which only sees the arrivals */
+/* if it is A: its next event if that is due before bound, else EVNIL    */
+evidx lp_nextevent(int entity, float bound)
+{
+   if (entity == A && arrival.evtime < bound && arrival.evtime <= earliest())
+      return ARRIVAL;
+   if (earliest() >= bound)
+      return EVNIL;
+   return popevent();
+}
+
+/* the event an index from nextevent() names */
+struct event *evget(evidx i)
+{
+   return i == ARRIVAL ? &arrival : eventat(i);
 }
 
 
@@ -171,7 +561,7 @@ void init(int seed)                         /* initialize the simulator */
    scanf("%d",&TRACE);
    */
 
-   srand(seed);              /* init random number generator */
+   initstate(seed, rngstate, sizeof(rngstate)); /* init random number generator */
    sum = 0.0;                /* test random number generator for students */
    for (i=0; i<1000; i++)
       sum=sum+jimsrand();    /* jimsrand() should be uniform in [0,1] */
@@ -186,9 +576,26 @@ void init(int seed)                         /* initialize the simulator */
    ntolayer3 = 0;
    nlost = 0;
    ncorrupt = 0;
+   nreordered = 0;
+   for (i=0; i<2; i++) {
+      lastarrival[i] = 0.0;
+      nsent3[i] = 0;
+      maxarrived3[i] = 0;
+      noutoforder[i] = 0;
+      }
+
+   arrivalrng[0] = 0x330E;          /* seed the arrival stream as */
+   arrivalrng[1] = seed;            /* srand48() would            */
+   arrivalrng[2] = seed >> 16;
+   nextgap = ARRIVAL_BATCH;
+   burstleft = 0;
+
+   readrng[0] = 0xB5E1;             /* and B's reads from a stream */
+   readrng[1] = seed;               /* of their own                */
+   readrng[2] = seed >> 16;
 
    time_local=0;                    /* initialize time to 0.0 */
-   generate_next_arrival();     /* initialize event list */
+   generate_next_arrival();     /* schedule the first arrival */
 }
 
 
@@ -244,25 +651,974 @@ float read_arg_float(char c)
 	return val;
 }
 
+int read_arg_dist(char c)
+{
+	if(strcmp(optarg, "uniform") == 0)
+		return DISP_UNIFORM;
+	if(strcmp(optarg, "exp") == 0)
+		return DISP_EXP;
+	fprintf(stderr, "Invalid value for -%c\n", c);
+	exit(-1);
+}
+
+int read_arg_arrivals(char c)
+{
+	if(strcmp(optarg, "uniform") == 0)
+		return ARRIVE_UNIFORM;
+	if(strcmp(optarg, "exp") == 0)
+		return ARRIVE_EXP;
+	if(strcmp(optarg, "cbr") == 0)
+		return ARRIVE_CBR;
+	if(strcmp(optarg, "onoff") == 0)
+		return ARRIVE_ONOFF;
+	fprintf(stderr, "Invalid value for -%c\n", c);
+	exit(-1);
+}
+
+/* parse an FEC block "k" or "k:r" (r parity packets, 1 by default) */
+/* into fecblock and fecparity                                      */
+int parse_fec(char *spec)
+{
+	char *colon = strchr(spec, ':');
+	int k, r = 1;
+
+	if (colon != NULL) {
+		*colon = '\0';
+		if (!isNumber(colon + 1) || colon[1] == '\0')
+			return 0;
+		r = atoi(colon + 1);
+	}
+	if (!isNumber(spec) || spec[0] == '\0')
+		return 0;
+	k = atoi(spec);
+	if (k > FEC_MAX_BLOCK || r < 1 || r > FEC_MAX_PARITY)
+		return 0;
+	fecblock = k;
+	fecparity = r;
+	return 1;
+}
+
 void display_usage(char *filename)
 {
-	printf("Usage:\n %s -s Seed -w Window size -m Number of messages to simulate -l Loss -c Corruption -t Average time between messages from sender's layer5 -v Tracing\n", filename);
+	printf("Usage:\n %s -s Seed -w Window size -m Number of messages to simulate -l Loss -c Corruption -t Average time between messages from sender's layer5 -v Tracing [-r Reorder probability -d Mean reorder displacement -D Displacement distribution (uniform|exp) -W Warm-up time -S Sample interval -o Binary results file -P Protocol (%s) -x Snapshot time -k Checkpoint file to write at the snapshot -R Checkpoint file to restore -F What-if variant to fork at the snapshot, e.g. l=0.4,w=20 (repeatable) -a Arrival process (uniform|exp|cbr|onoff) -b Mean messages per on-off burst -q Send buffer size in messages, blocking the application when full -f FEC block, k data packets or k:r with r parity packets (GBN and SR) -C Mean time B's application takes to read a message -M Live metrics file, see monitor -p Profile the event loop in CPU cycles -j Threads to run A and B on as parallel logical processes (1 runs the same partitioned model on one) -T Topology file of routers and links to cross instead of a single hop, whose links' loss and corruption replace -l and -c -A Workload file of messages to replay instead of generating them, see capture; -t then scales its recorded gaps, 1 keeping its timing -g Pace A's packets over each round trip, at most this many back to back (GBN)]\n", filename, PROTOCOL_NAMES);
 }
 
-int main(int argc, char **argv)
+/* print one time-series sample: goodput and retransmissions per time */
+/* unit over the last interval, and the packets currently in flight    */
+void sample(float t)
 {
-   struct event *eventptr;
+  if (t < warmup)
+     return;
+  printf("[TS] time: %f goodput: %f inflight: %d retransmit_rate: %f\n", t,
+         (B_application - lastsampleB)/sampleint, ninflight,
+         (nretransmit - lastsampleretx)/sampleint);
+  lastsampleB = B_application;
+  lastsampleretx = nretransmit;
+}
+
+/* append this run's configuration, counters and delay quantiles */
+/* to the binary results file given with -o                        */
+void write_results(const char *protoname, int seed)
+{
+  struct results_writer *w;
+  struct result_row row;
+
+  memset(&row, 0, sizeof(row));
+  strncpy(row.protocol, protoname, sizeof(row.protocol) - 1);
+  row.seed = seed;
+  row.window = win_size;
+  row.messages = nsimmax;
+  row.loss = lossprob;
+  row.corrupt = corruptprob;
+  row.lambda = lambda;
+  row.A_application = A_application;
+  row.A_transport = A_transport;
+  row.B_transport = B_transport;
+  row.B_application = B_application;
+  row.retransmissions = nretransmit;
+  row.total_time = time_local;
+  row.throughput = B_application/time_local;
+  row.goodput = ngoodput/time_local;
+  row.duplicates = nduplicate;
+  row.out_of_order = nlate;
+  row.unmatched = nunmatched;
+  row.skipped = nskipped;
+  row.delay_mean = delayhist.total > 0 ? delayhist.sum/delayhist.total : 0.0;
+  row.delay_p50 = hist_quantile(&delayhist, 0.5);
+  row.delay_p99 = hist_quantile(&delayhist, 0.99);
+  row.delay_p999 = hist_quantile(&delayhist, 0.999);
+  row.delay_max = delayhist.max;
+  row.buffer_limit = bufsize;
+  row.buffer_max = maxoccupancy;
+  row.buffer_mean = time_local > 0.0 ? occupancyarea/time_local : 0.0;
+  row.blocked_time = blockedtime;
+  row.refused = nrefused;
+  row.fec_block = fecblock;
+  row.fec_parity = fecblock > 0 ? fecparity : 0;
+  row.fec_parity_sent = fec_parity_sent;
+  row.fec_recovered = fec_recovered;
+  row.pacing = pacing;
+  row.burst_max = maxburst;
+  row.burst_mean = nbursts > 0 ? (double)A_transport/nbursts : 0.0;
+  row.read_time = readtime;
+  row.unread_max = maxunread;
+  row.events = nsimevents;
+  row.wall_time = profwall;
+  row.hops = topopath != NULL ? topo_hops(&topo, B) : 1;
+  row.queue_drops = topopath != NULL ? topo_dropped(&topo) : 0;
+
+  if ((w = results_open(resultspath)) == NULL) {
+     perror(resultspath);
+     return;
+     }
+  results_append(w, &row);
+  if (!results_close(w))
+     fprintf(stderr, "Unable to write results to %s\n", resultspath);
+}
+
+/* seconds of wall time, from an arbitrary origin */
+double wallclock()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec/1e9;
+}
+
+/* start publishing live metrics to path, giving up on the run if it */
+/* cannot be created                                                  */
+void open_metrics(const char *path)
+{
+  if ((metrics = metrics_create(path)) == NULL) {
+     perror(path);
+     exit(-1);
+     }
+  metricsstart = metricslast = wallclock();
+  metricslastevents = nsimevents;
+  metricslasttime = time_local;
+  metricslastB = B_application;
+  metricscountdown = METRICS_CHECK;
+}
+
+/* publish a snapshot of the run to the metrics page */
+void publish_metrics(const char *protoname, int done)
+{
+  struct metrics_page m;
+  double now = wallclock();
+
+  memset(&m, 0, sizeof(m));
+  m.pid = getpid();
+  strncpy(m.protocol, protoname, sizeof(m.protocol) - 1);
+  m.done = done;
+  m.blocked = blocked;
+  m.sim_time = time_local;
+  m.wall_time = now - metricsstart;
+  m.nsim = nsim;
+  m.nsimmax = nsimmax;
+  m.evlist = nevlist;
+  m.evlist_max = maxevlist;
+  m.events = nsimevents;
+  if (now > metricslast)
+     m.events_per_sec = (nsimevents - metricslastevents)/(now - metricslast);
+  m.A_application = A_application;
+  m.A_transport = A_transport;
+  m.B_transport = B_transport;
+  m.B_application = B_application;
+  m.retransmissions = nretransmit;
+  m.inflight = ninflight;
+  if (time_local > 0.0)
+     m.throughput = B_application/time_local;
+  if (time_local > metricslasttime)
+     m.recent_throughput = (B_application - metricslastB)/(time_local - metricslasttime);
+  metrics_publish(metrics, &m);
+
+  metricslast = now;
+  metricslastevents = nsimevents;
+  metricslasttime = time_local;
+  metricslastB = B_application;
+}
+
+/* print the -p profile: where the event loop's time went */
+void print_profile()
+{
+  int i;
+  struct histogram *h;
+
+  printf(" Profile: %llu events in %f s of wall time, %.0f events/s, "
+         "event list at most %d long\n", nsimevents, profwall,
+         profwall > 0.0 ? nsimevents/profwall : 0.0, maxevlist);
+#if defined(__x86_64__) || defined(__i386__)
+  printf("  cycle counter at %.3f GHz\n",
+         profwall > 0.0 ? profcycles/profwall/1e9 : 0.0);
+#else
+  printf("  no cycle counter, figures are in nanoseconds\n");
+#endif
+  printf("  %-17s %12s %14s %10s %10s %10s %10s %12s\n", "cycles in",
+         "count", "total", "share", "mean", "p50", "p99", "max");
+  for (i=0; i < NPROF; i++) {
+     h = &profhist[i];
+     if (h->total == 0)
+        continue;
+     printf("  %-17s %12llu %14.0f %9.2f%% %10.1f %10.0f %10.0f %12.0f\n",
+            profnames[i], (unsigned long long)h->total, h->sum,
+            profcycles > 0 ? 100.0*h->sum/profcycles : 0.0,
+            h->sum/h->total, hist_quantile(h, 0.5), hist_quantile(h, 0.99),
+            h->max);
+     }
+}
+
+/* write the whole simulation state to path (see checkpoint.h) */
+void save_checkpoint(const char *path, const char *protoname,
+                     void (*save_state)(FILE *f))
+{
+  FILE *f;
+  struct event *q;
+  evidx i;
+  char name[8];
+  int nevents;
+
+  if ((f = fopen(path, "wb")) == NULL) {
+     perror(path);
+     exit(-1);
+     }
+  memset(name, 0, sizeof(name));
+  strncpy(name, protoname, sizeof(name) - 1);
+  fwrite(CKPT_MAGIC, 4, 1, f);
+  ckpt_put(f, (uint32_t)CKPT_VERSION);
+  fwrite(name, sizeof(name), 1, f);
+
+  setstate(rngstate);        /* stores the generator's position in rngstate */
+  fwrite(rngstate, sizeof(rngstate), 1, f);
+#define CKPT_PUT(var) ckpt_put(f, var);
+  CKPT_STATE(CKPT_PUT)
+#undef CKPT_PUT
+
+  for (nevents=0, i=evlist; i!=EVNIL; i=eventat(i)->next)
+     nevents++;
+  ckpt_put(f, nevents);
+  for (i=evlist; i!=EVNIL; i=q->next) {
+     q = eventat(i);
+     ckpt_put(f, q->evtime);
+     ckpt_put(f, q->evtype);
+     ckpt_put(f, q->eventity);
+     ckpt_put(f, q->sendidx);
+     if (q->evtype == FROM_LAYER3)
+        ckpt_put(f, q->pkt);
+     }
+
+  track_save(f);
+  save_state(f);
+  if (ferror(f) | fclose(f)) {
+     fprintf(stderr, "Unable to write checkpoint %s\n", path);
+     exit(-1);
+     }
+}
+
+/* replace the simulation state with the one saved in path */
+void restore_checkpoint(const char *path, const char *protoname,
+                        bool (*load_state)(FILE *f))
+{
+  FILE *f;
+  struct event *p;
+  evidx j, tail;
+  char magic[4], name[9];
+  uint32_t version;
+  int i, nevents, ok;
+
+  if ((f = fopen(path, "rb")) == NULL) {
+     perror(path);
+     exit(-1);
+     }
+  memset(name, 0, sizeof(name));
+  ok = fread(magic, 4, 1, f) == 1 && memcmp(magic, CKPT_MAGIC, 4) == 0 &&
+       ckpt_get(f, version) && version == CKPT_VERSION &&
+       fread(name, 8, 1, f) == 1 &&
+       fread(rngstate, sizeof(rngstate), 1, f) == 1;
+  if (ok && strcmp(name, protoname) != 0) {
+     fprintf(stderr, "Checkpoint %s was taken with protocol %s, not %s\n",
+             path, name, protoname);
+     exit(-1);
+     }
+#define CKPT_GET(var) ok = ok && ckpt_get(f, var);
+  CKPT_STATE(CKPT_GET)
+#undef CKPT_GET
+  ok = ok && ckpt_get(f, nevents);
+
+  /* the events were saved in time order, so append rather than insert */
+  evlist = tail = EVNIL;
+  nevlist = maxevlist = nevents;
+  for (i=0; ok && i < nevents; i++) {
+     j = newevent();
+     p = eventat(j);
+     p->prev = tail;
+     p->next = EVNIL;
+     ok = ckpt_get(f, p->evtime) && ckpt_get(f, p->evtype) &&
+          ckpt_get(f, p->eventity) && ckpt_get(f, p->sendidx);
+     if (ok && p->evtype == FROM_LAYER3)
+        ok = ckpt_get(f, p->pkt);
+     if (tail == EVNIL)
+        evlist = j;
+       else
+        eventat(tail)->next = j;
+     tail = j;
+     }
+
+  ok = ok && track_load(f) && load_state(f);
+  fclose(f);
+  if (!ok) {
+     fprintf(stderr, "Malformed checkpoint %s\n", path);
+     exit(-1);
+     }
+  setstate(rngstate);
+}
+
+/* change this run's parameters as a variant such as "l=0.4,w=20" says: */
+/* l loss, c corruption, w window, t time between messages, q send      */
+/* buffer size, f FEC block, C read time at B, g pacing burst           */
+void apply_variant(char *spec)
+{
+  char *item, *value;
+  float x;
+
+  for (item = strtok(spec, ","); item != NULL; item = strtok(NULL, ",")) {
+     if ((value = strchr(item, '=')) == NULL || value[1] == '\0')
+        goto invalid;
+     *value++ = '\0';
+     x = atof(value);
+     if (strcmp(item, "l") == 0 && x >= 0.0 && x <= 1.0)
+        lossprob = x;
+       else if (strcmp(item, "c") == 0 && x >= 0.0 && x <= 1.0)
+        corruptprob = x;
+       else if (strcmp(item, "w") == 0 && isNumber(value) && atoi(value) > 0)
+        win_size = atoi(value);
+       else if (strcmp(item, "t") == 0 && x > 0.0)
+        lambda = x;
+       else if (strcmp(item, "q") == 0 && isNumber(value))
+        bufsize = atoi(value);
+       else if (strcmp(item, "f") == 0 && parse_fec(value))
+        ;
+       else if (strcmp(item, "C") == 0 && x >= 0.0)
+        readtime = x;
+       else if (strcmp(item, "g") == 0 && isNumber(value))
+        pacing = atoi(value);
+       else
+        goto invalid;
+     }
+  return;
+
+invalid:
+  fprintf(stderr, "Invalid variant: %s\n", item);
+  exit(-1);
+}
+
+/* fork one continuation per variant. Each child carries on from this   */
+/* exact state with its variant applied, writing its report to a temp  */
+/* file; the parent waits for them all, prints the reports in order    */
+/* and exits.                                                           */
+template <class P> void branch()
+{
+  FILE *out[MAXVARIANTS];
+  char buf[4096];
+  pid_t pid;
+  int k, n, status, failed = 0;
+
+  fflush(stdout);
+  for (k=0; k < nvariants; k++) {
+     if ((out[k] = tmpfile()) == NULL || (pid = fork()) < 0) {
+        perror("fork");
+        exit(-1);
+        }
+     if (pid == 0) {
+        dup2(fileno(out[k]), STDOUT_FILENO);
+        printf(" Continuation %d of %d from time %f: %s\n\n", k + 1,
+               nvariants, time_local, variants[k]);
+        if (metrics != NULL) {  /* each continuation gets its own page */
+           snprintf(buf, sizeof(buf), "%s.%d", metricspath, k + 1);
+           open_metrics(buf);
+           }
+        apply_variant(variants[k]);
+        P::reconfigure();
+        return;                /* the child runs on in the event loop */
+        }
+     }
+
+  if (metrics != NULL)           /* the parent's part of the run ends here */
+     publish_metrics(P::name(), 1);
+  for (k=0; k < nvariants; k++) {
+     wait(&status);
+     if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        failed++;
+     }
+  for (k=0; k < nvariants; k++) {
+     if (k > 0)
+        printf("\n");
+     rewind(out[k]);
+     while ((n = fread(buf, 1, sizeof(buf), out[k])) > 0)
+        fwrite(buf, 1, n, stdout);
+     fclose(out[k]);
+     }
+  if (failed > 0)
+     fprintf(stderr, "%d of %d continuations failed\n", failed, nvariants);
+  exit(failed > 0 ? -1 : 0);
+}
+
+/* the state at snapat: write the checkpoint and/or fork the variants */
+template <class P> void snapshot()
+{
+  if (ckptpath != NULL) {
+     save_checkpoint(ckptpath, P::name(), P::save_state);
+     if (TRACE>0)
+        printf("          CHECKPOINT: written to %s\n", ckptpath);
+     }
+  if (nvariants > 0)
+     branch<P>();
+}
+
+/* offer msg to A, timing the call with -p */
+template <class P> bool A_output(struct msg *msg)
+{
+   PROFILE(PROF_A_OUTPUT);
+   return P::A_output(*msg);
+}
+
+/* hand msg to A. If A refuses it the application blocks on it when */
+/* there is a send buffer, and the message is lost otherwise.        */
+template <class P> void give_to_A(struct msg *msg)
+{
+   if (A_output<P>(msg))
+      return;
+   if (bufsize == 0) {
+      nrefused++;
+      track_msg_refused(nsim - 1);
+      return;
+      }
+   if (TRACE>2)
+      printf("          BACKPRESSURE: A refused the message, application blocked\n");
+   blocked = 1;
+   heldmsg = *msg;
+   blockedsince = time_local;
+   blockedgap = arrival.evtime - time_local;
+   arrival.evtime = NEVER;
+   nblocked++;
+}
+
+/* offer a blocked application's message to A again, resuming the */
+/* arrivals if A takes it                                          */
+template <class P> void retry_blocked()
+{
+   if (!A_output<P>(&heldmsg))
+      return;
+   if (TRACE>2)
+      printf("          BACKPRESSURE: A took the message, application resumed\n");
+   blocked = 0;
+   blockedtime += time_local - blockedsince;
+   arrival.evtime = time_local + blockedgap;
+}
+
+/* seed each LP's channel stream, and run init() as A so the first */
+/* arrival is drawn from A's                                      */
+void lp_init(int seed)
+{
+   int i;
+
+   for (i=0; i < NLPS; i++) {
+      lps[i].entity = i;
+      lps[i].rng[0] = 0xC4A0 + i;
+      lps[i].rng[1] = seed;
+      lps[i].rng[2] = seed >> 16;
+      lps[i].evlist = EVNIL;
+      lps[i].evarena.free = EVNIL;
+      }
+   curlp = &lps[A];
+}
+
+/* swap an LP's state into this thread's globals, and back out */
+void lp_enter(struct lp *p)
+{
+#define LP_IN(var) var = p->var;
+   LP_STATE(LP_IN)
+#undef LP_IN
+   curlp = p;
+}
+
+void lp_leave(struct lp *p)
+{
+#define LP_OUT(var) p->var = var;
+   LP_STATE(LP_OUT)
+#undef LP_OUT
+   curlp = NULL;
+}
+
+/* when an LP's earliest event is due, NEVER if it has none */
+float lp_earliest(struct lp *p)
+{
+   float t = p->evlist != EVNIL ? arenaat(&p->evarena, p->evlist)->evtime
+                                : NEVER;
+
+   if (p->entity == A && arrival.evtime < t)
+      t = arrival.evtime;
+   return t;
+}
+
+/* hand a packet the running LP sent to its destination's inbox, for */
+/* the next window. The destination has an arena of its own, so the  */
+/* event is copied there and freed here.                             */
+void post(evidx i)
+{
+   struct event *p = eventat(i);
+   int w = curlp->window % 2, to = p->eventity;
+
+   if (curlp->nout[w][to] == curlp->maxout[w][to]) {
+      curlp->maxout[w][to] =
+         curlp->maxout[w][to] > 0 ? 2*curlp->maxout[w][to] : 64;
+      curlp->outbox[w][to] = (struct event *)realloc(curlp->outbox[w][to],
+                                curlp->maxout[w][to]*sizeof(struct event));
+      if (curlp->outbox[w][to] == NULL) {
+         perror("realloc");
+         exit(-1);
+         }
+      }
+   curlp->outbox[w][to][curlp->nout[w][to]++] = *p;
+   if (p->evtime < curlp->outmin[w])
+      curlp->outmin[w] = p->evtime;
+   freeevent(i);
+}
+
+/* count a delivery at B's layer 5 at time t, and match it to the */
+/* message A was handed, to validate it and for the delay         */
+/* histogram                                                      */
+void match_delivery(char *data, float t)
+{
+   float sent;
+   int skipped;
+
+   if (t >= warmup)
+      B_steady++;
+   switch (track_msg_delivered(data, &sent, &skipped)) {
+     case DELIVERY_GAP:
+       ngaps++;
+       nskipped += skipped;
+       /* and it is in order from here on */
+     case DELIVERY_INORDER:
+       ngoodput++;
+       if (sent >= warmup)
+          hist_record(&delayhist, t - sent);
+       break;
+     case DELIVERY_LATE:
+       nlate++;
+       break;
+     case DELIVERY_DUPLICATE:
+       nduplicate++;
+       break;
+     default:
+       nunmatched++;
+     }
+}
+
+/* log a delivery at B's layer 5 in a partitioned run, for A to match */
+void log_delivery(char *data)
+{
+   int w = curlp->window % 2;
+   struct delivery *d;
+
+   if (curlp->nlog[w] == curlp->maxlog[w]) {
+      curlp->maxlog[w] = curlp->maxlog[w] > 0 ? 2*curlp->maxlog[w] : 64;
+      curlp->log[w] = (struct delivery *)realloc(curlp->log[w],
+                          curlp->maxlog[w]*sizeof(struct delivery));
+      if (curlp->log[w] == NULL) {
+         perror("realloc");
+         exit(-1);
+         }
+      }
+   d = &curlp->log[w][curlp->nlog[w]++];
+   d->time = time_local;
+   memcpy(d->data, data, sizeof(d->data));
+}
+
+/* match the deliveries an LP logged in window w */
+void match_log(struct lp *p, int w)
+{
+   int i;
+
+   for (i=0; i < p->nlog[w % 2]; i++)
+      match_delivery(p->log[w % 2][i].data, p->log[w % 2][i].time);
+   p->nlog[w % 2] = 0;
+}
+
+/* corrupt a packet in the medium: its payload, or else its seqnum or */
+/* acknum                                                             */
+void corrupt_packet(struct pkt *p)
+{
+   float x;
+
+   ncorrupt++;
+   if ( (x = jimsrand()) < .75)
+      p->payload[0]='Z';   /* corrupt payload */
+     else if (x < .875)
+      p->seqnum = 999999;
+     else
+      p->acknum = 999999;
+   if (TRACE>0)
+      printf("          TOLAYER3: packet being corrupted\n");
+}
+
+/* forward the packet of a routed event from node over the next link */
+/* toward the host it is for. It is due at the far end after the     */
+/* link's queue, its delay and the packets ahead of it there: at the */
+/* host as FROM_LAYER3, at a router as AT_ROUTER. A packet the link  */
+/* drops or loses is freed with its event.                           */
+void hop(evidx i, int node)
+{
+   struct event *evptr = eventat(i);
+   struct topo_link *link = topo_next(&topo, node, evptr->eventity);
+   float depart, lastime;
+
+   if (!topo_enqueue(link, time_local, &depart)) {
+      if (TRACE>0)
+         printf("          HOP %s->%s: packet dropped by a full queue\n",
+                topo.nodes[link->from].c_str(), topo.nodes[link->to].c_str());
+      ninflight--;
+      freeevent(i);
+      return;
+      }
+   if (jimsrand() < link->loss) {
+      link->lost++;
+      nlost++;
+      if (TRACE>0)
+         printf("          HOP %s->%s: packet being lost\n",
+                topo.nodes[link->from].c_str(), topo.nodes[link->to].c_str());
+      ninflight--;
+      freeevent(i);
+      return;
+      }
+   lastime = depart;
+   if (link->lastarrival > lastime)
+      lastime = link->lastarrival;
+   evptr->evtime = lastime + link->delay + link->jitter*jimsrand();
+   link->lastarrival = evptr->evtime;
+   if (jimsrand() < link->corrupt) {
+      link->corrupted++;
+      corrupt_packet(&evptr->pkt);
+      }
+   evptr->node = link->to;
+   evptr->evtype = link->to == evptr->eventity ? FROM_LAYER3 : AT_ROUTER;
+   insertevent(i);
+}
+
+/* hand the packet of a new event from a host to the first link of */
+/* its route (see -T)                                              */
+void send_routed(int AorB, evidx i)
+{
+   struct event *evptr = eventat(i);
+
+   evptr->eventity = (AorB+1) % 2;
+   evptr->sendidx = ++nsent3[evptr->eventity];
+   ninflight++;
+   hop(i, AorB);
+}
+
+/* print an event about to be simulated, with -v 2 and up */
+void trace_event(struct event *eventptr)
+{
+   printf("\nEVENT time: %f,",eventptr->evtime);
+   printf("  type: %d",eventptr->evtype);
+   if (eventptr->evtype==0)
+      printf(", timerinterrupt  ");
+     else if (eventptr->evtype==1)
+      printf(", fromlayer5 ");
+     else if (eventptr->evtype==2)
+      printf(", fromlayer3 ");
+     else
+      printf(", atrouter %s ", topo.nodes[eventptr->node].c_str());
+   printf(" entity: %d\n",eventptr->eventity);
+}
+
+/* simulate one event at time_local: hand a message to A, deliver a */
+/* packet, or run A's timer                                         */
+template <class P> void handle(evidx id)
+{
+   struct event *eventptr = evget(id);
    struct msg  msg2give;
    struct pkt  pkt2give;
+   /* the protocol may create events, which can move the arena, so */
+   /* eventptr is not to be used once it has been called            */
+   int i,j,entity = eventptr->eventity,type = eventptr->evtype;
+
+   PROFILE(PROF_EV_TIMER + type);
+   if (type == FROM_LAYER5 ) {
+       generate_next_arrival();   /* set up future arrival */
+       /* fill in msg to give with string of same letter, */
+       /* or the recorded payload of a replayed message,  */
+       /* stamping the message number in base 26 into the */
+       /* tail so every outstanding message is distinct   */
+       j = nsim % 26; 
+       if (arrivaldist == ARRIVE_REPLAY)
+          memcpy(msg2give.data, workload.records[nsim].data, 20);
+         else
+          for (i=0; i<20; i++)  
+             msg2give.data[i] = 97 + j;
+       for (i=19, j=nsim; i>=14; i--, j/=26)
+          msg2give.data[i] = 97 + j % 26;
+       if (TRACE>2) {
+          printf("          MAINLOOP: data given to student: ");
+            for (i=0; i<20; i++) 
+             printf("%c", msg2give.data[i]);
+          printf("\n");
+          }
+       nsim++;
+       if (entity == A)
+       {
+           A_application += 1;
+           track_msg_sent(nsim - 1, time_local, msg2give.data);
+           give_to_A<P>(&msg2give);
+       }  
+       /*
+        else
+          B_output(msg2give);  
+          */
+       }
+     else if (eventptr->evtype ==  FROM_LAYER3) {
+       ninflight--;
+       pkt2give = eventptr->pkt;
+       if (eventptr->sendidx < maxarrived3[eventptr->eventity])
+          noutoforder[eventptr->eventity]++;
+         else
+          maxarrived3[eventptr->eventity] = eventptr->sendidx;
+       if (eventptr->eventity ==A) {    /* deliver packet by calling */
+          PROFILE(PROF_A_INPUT);
+          P::A_input(pkt2give);            /* appropriate entity */
+          }
+       else
+       {
+          PROFILE(PROF_B_INPUT);
+          B_transport += 1;
+          P::B_input(pkt2give);
+       }
+       }
+     else if (eventptr->evtype ==  AT_ROUTER) {
+       hop(id, eventptr->node);         /* stored, now forwarded */
+       return;                          /* with its event, if not dropped */
+       }
+     else if (eventptr->evtype ==  TIMER_INTERRUPT) {
+       if (eventptr->eventity == A) {
+          PROFILE(PROF_A_TIMER);
+          P::A_timerinterrupt();
+          }
+       /*
+        else
+          B_timerinterrupt();
+          */
+        }
+     else  {
+        printf("INTERNAL PANIC: unknown event type \n");
+        }
+   if (blocked && entity == A && type != FROM_LAYER5)
+      retry_blocked<P>();
+   /* only A's events change what A holds */
+   if (entity == A && (occupancy = P::backlog()) > maxoccupancy)
+      maxoccupancy = occupancy;
+   if (id != ARRIVAL)
+      freeevent(id);
+}
+
+/* run an LP's part of window w, its events due before bound, after */
+/* taking in what the other LPs posted to it in the window before   */
+template <class P> void lp_window(struct lp *p, int w, float bound)
+{
+   struct event *eventptr;
+   evidx id;
+   int i, j, last = (w + 1) % 2;
+
+   lp_enter(p);
+   p->window = w;
+   p->outmin[w % 2] = NEVER;
+   for (i=0; i < NLPS; i++) {
+      for (j=0; j < lps[i].nout[last][p->entity]; j++) {
+         id = newevent();
+         *eventat(id) = lps[i].outbox[last][p->entity][j];
+         insertevent(id);
+         }
+      lps[i].nout[last][p->entity] = 0;
+      if (p->entity == A)          /* A owns the message tracker */
+         match_log(&lps[i], last);
+      }
+   while ((id = lp_nextevent(p->entity, bound)) != EVNIL) {
+      eventptr = evget(id);
+      if (TRACE>=2)
+         trace_event(eventptr);
+      if (p->entity == A)
+         occupancyarea += occupancy * (double)(eventptr->evtime - time_local);
+      time_local = eventptr->evtime;
+      if (p->entity == A && nsim==nsimmax && !blocked) {
+         p->done[w % 2] = 1;       /* all done with simulation */
+         break;
+         }
+      handle<P>(id);
+      nsimevents++;
+      }
+   lp_leave(p);
+   p->next[w % 2] = lp_earliest(p);
+}
+
+/* a thread of a partitioned run: it runs LPs id, id + nthreads and so */
+/* on, window by window, until A is done or nothing is left to do      */
+template <class P> void *run_lps(void *arg)
+{
+   long id = (long)arg;
+   float start = firstwindow;
+   int i, w, done;
+
+   for (w=0; ; w++) {
+      for (i=id; i < NLPS; i += nthreads)
+         lp_window<P>(&lps[i], w, start + LOOKAHEAD);
+      pthread_barrier_wait(&windowbarrier);
+      /* every thread works out the next window from the same state */
+      start = NEVER;
+      done = 0;
+      for (i=0; i < NLPS; i++) {
+         if (lps[i].next[w % 2] < start)
+            start = lps[i].next[w % 2];
+         if (lps[i].outmin[w % 2] < start)
+            start = lps[i].outmin[w % 2];
+         done |= lps[i].done[w % 2];
+         }
+      if (done || start >= NEVER) {
+         if (id == 0)
+            nwindows = w + 1;
+         return NULL;
+         }
+      }
+}
+
+/* run the simulation partitioned into LPs (see -j) on nthreads threads, */
+/* then gather their state back into the globals for the report          */
+template <class P> void simulate_partitioned()
+{
+   pthread_t threads[NLPS];
+   long i;
+
+   P::A_init();                    /* init() ran as A, see lp_init() */
+   lp_leave(&lps[A]);
+   lp_enter(&lps[B]);
+   P::B_init();
+   lp_leave(&lps[B]);
+   firstwindow = NEVER;
+   for (i=0; i < NLPS; i++)
+      if (lp_earliest(&lps[i]) < firstwindow)
+         firstwindow = lp_earliest(&lps[i]);
+
+   pthread_barrier_init(&windowbarrier, NULL, nthreads);
+   for (i=1; i < nthreads; i++)
+      if (pthread_create(&threads[i], NULL, run_lps<P>, (void *)i) != 0) {
+         perror("pthread_create");
+         exit(-1);
+         }
+   run_lps<P>((void *)0);
+   for (i=1; i < nthreads; i++)
+      pthread_join(threads[i], NULL);
+   pthread_barrier_destroy(&windowbarrier);
+
+   time_local = 0;
+   ntolayer3 = nlost = ncorrupt = nreordered = ninflight = 0;
+   nsimevents = 0;
+   maxevlist = 0;
+   for (i=0; i < NLPS; i++) {
+      match_log(&lps[i], nwindows - 1);  /* the last window's deliveries */
+      if (lps[i].time_local > time_local)
+         time_local = lps[i].time_local;
+      ntolayer3 += lps[i].ntolayer3;
+      nlost += lps[i].nlost;
+      ncorrupt += lps[i].ncorrupt;
+      nreordered += lps[i].nreordered;
+      ninflight += lps[i].ninflight;
+      nsimevents += lps[i].nsimevents;
+      if (lps[i].maxevlist > maxevlist)
+         maxevlist = lps[i].maxevlist;
+      }
+
+   if (!lps[A].done[(nwindows - 1) % 2])
+      printf("INTERNAL PANIC: application blocked but A has nothing left to do\n");
+   if (blocked)
+      blockedtime += time_local - blockedsince;
+}
+
+/* run the event loop, merging the event list with the arrivals, until */
+/* nsimmax messages have been handed over. It is instantiated once per  */
+/* protocol (see protocol.h) so every call into the protocol is a      */
+/* direct call.                                                         */
+template <class P> void simulate()
+{
+   struct event *eventptr;
+   evidx id;
+
+   if (nthreads > 0) {
+      simulate_partitioned<P>();
+      return;
+      }
+   if (restorepath != NULL) {
+      restore_checkpoint(restorepath, P::name(), P::load_state);
+      P::reconfigure();           /* the command line may change -w */
+      }
+     else {
+      P::A_init();
+      P::B_init();
+      }
+   if (metrics != NULL)
+      publish_metrics(P::name(), 0);
    
-   int i,j;
+   while (1) {
+        if (snapat >= 0.0 && earliest() >= snapat && arrival.evtime >= snapat) {
+           snapat = -1.0;
+           snapshot<P>();
+           }
+        if (blocked && evlist == EVNIL) {
+           printf("INTERNAL PANIC: application blocked but A has nothing left to do\n");
+           break;
+           }
+        id = nextevent();             /* get next event to simulate */
+        eventptr = evget(id);
+        if (TRACE>=2)
+           trace_event(eventptr);
+        while (sampleint > 0.0 && nextsample <= eventptr->evtime) {
+           sample(nextsample);
+           nextsample += sampleint;
+           }
+        occupancyarea += occupancy * (double)(eventptr->evtime - time_local);
+        time_local = eventptr->evtime;        /* update time to next event time */
+        if (nsim==nsimmax && !blocked)
+	  break;                        /* all done with simulation */
+        handle<P>(id);
+        nsimevents++;
+        if (metrics != NULL && --metricscountdown == 0) {
+           metricscountdown = METRICS_CHECK;
+           if (wallclock() - metricslast >= METRICS_PERIOD)
+              publish_metrics(P::name(), 0);
+           }
+        }
+   if (blocked)
+      blockedtime += time_local - blockedsince;
+   if (metrics != NULL)
+      publish_metrics(P::name(), 1);
+}
+
+static const struct {
+   const char *name;
+   void (*run)();
+} simulations[] = { PROTOCOL_TABLE(simulate) };
+#define NSIMULATIONS (sizeof(simulations) / sizeof(simulations[0]))
+
+int main(int argc, char **argv)
+{
+   int i;
    char c; 
   
    int opt;
    int seed;
+   const char *protoname = NULL;
+   const struct protocol *proto;
+   void (*run)() = NULL;
 
    //Check for number of arguments
-   if(argc != 15){
+   if(argc < 15){
    		fprintf(stderr, "Missing arguments!\n");
 		display_usage(argv[0]);
 		return -1;
@@ -272,7 +1628,7 @@ int main(int argc, char **argv)
     * Parse the arguments 
     * http://www.gnu.org/software/libc/manual/html_node/Example-of-Getopt.html 
     */
-    while((opt = getopt(argc, argv,"s:w:m:l:c:t:v:")) != -1){
+    while((opt = getopt(argc, argv,"s:w:m:l:c:t:v:r:d:D:W:S:o:P:x:k:R:F:a:b:q:f:C:M:pj:T:A:g:")) != -1){
     	switch (opt){
     		case 's':   seed = read_arg_int(opt);
                     	break;
@@ -291,6 +1647,80 @@ int main(int argc, char **argv)
             			break;
             case 'v': 	TRACE = read_arg_int(opt);
             			break;
+            case 'r': 	reorderprob = read_arg_float(opt);
+            			break;
+            case 'd': 	if((reorderdisp = atof(optarg)) < 0.0){
+            				fprintf(stderr, "Invalid value for -%c\n", opt);
+							exit(-1);
+            			}
+            			break;
+            case 'D': 	reorderdist = read_arg_dist(opt);
+            			break;
+            case 'W': 	if((warmup = atof(optarg)) < 0.0){
+            				fprintf(stderr, "Invalid value for -%c\n", opt);
+							exit(-1);
+            			}
+            			break;
+            case 'o': 	resultspath = optarg;
+            			break;
+            case 'M': 	metricspath = optarg;
+            			break;
+            case 'p': 	profiling = 1;
+            			break;
+            case 'j': 	if((nthreads = read_arg_int(opt)) < 1){
+            				fprintf(stderr, "Invalid value for -%c\n", opt);
+							exit(-1);
+            			}
+            			if(nthreads > NLPS)	/* one thread per LP at most */
+            				nthreads = NLPS;
+            			break;
+            case 'A': 	workloadpath = optarg;
+            			break;
+            case 'T': 	topopath = optarg;
+            			break;
+            case 'P': 	protoname = optarg;
+            			break;
+            case 'x': 	if((snapat = atof(optarg)) < 0.0){
+            				fprintf(stderr, "Invalid value for -%c\n", opt);
+							exit(-1);
+            			}
+            			break;
+            case 'k': 	ckptpath = optarg;
+            			break;
+            case 'R': 	restorepath = optarg;
+            			break;
+            case 'F': 	if(nvariants == MAXVARIANTS){
+            				fprintf(stderr, "Too many -%c variants\n", opt);
+							exit(-1);
+            			}
+            			variants[nvariants++] = optarg;
+            			break;
+            case 'a': 	arrivaldist = read_arg_arrivals(opt);
+            			break;
+            case 'b': 	if((burstlen = atof(optarg)) < 1.0){
+            				fprintf(stderr, "Invalid value for -%c\n", opt);
+							exit(-1);
+            			}
+            			break;
+            case 'q': 	bufsize = read_arg_int(opt);
+            			break;
+            case 'g': 	pacing = read_arg_int(opt);
+            			break;
+            case 'C': 	if((readtime = atof(optarg)) < 0.0){
+            				fprintf(stderr, "Invalid value for -%c\n", opt);
+							exit(-1);
+            			}
+            			break;
+            case 'f': 	if(!parse_fec(optarg)){
+            				fprintf(stderr, "Invalid value for -%c\n", opt);
+							exit(-1);
+            			}
+            			break;
+            case 'S': 	if((sampleint = atof(optarg)) < 0.0){
+            				fprintf(stderr, "Invalid value for -%c\n", opt);
+							exit(-1);
+            			}
+            			break;
             case '?':   
            	default:    fprintf(stderr, "Invalid arguments!\n");
 						display_usage(argv[0]);
@@ -298,84 +1728,83 @@ int main(int argc, char **argv)
        }
     }
   
-   init(seed);
-   A_init();
-   B_init();
-   
-   while (1) {
-        eventptr = evlist;            /* get next event to simulate */
-        if (eventptr==NULL)
-           goto terminate;
-        evlist = evlist->next;        /* remove this event from event list */
-        if (evlist!=NULL)
-           evlist->prev=NULL;
-        if (TRACE>=2) {
-           printf("\nEVENT time: %f,",eventptr->evtime);
-           printf("  type: %d",eventptr->evtype);
-           if (eventptr->evtype==0)
-	       printf(", timerinterrupt  ");
-             else if (eventptr->evtype==1)
-               printf(", fromlayer5 ");
-             else
-	     printf(", fromlayer3 ");
-           printf(" entity: %d\n",eventptr->eventity);
-           }
-        time_local = eventptr->evtime;        /* update time to next event time */
-        if (nsim==nsimmax)
-	  break;                        /* all done with simulation */
-        if (eventptr->evtype == FROM_LAYER5 ) {
-            generate_next_arrival();   /* set up future arrival */
-            /* fill in msg to give with string of same letter */    
-            j = nsim % 26; 
-            for (i=0; i<20; i++)  
-               msg2give.data[i] = 97 + j;
-            if (TRACE>2) {
-               printf("          MAINLOOP: data given to student: ");
-                 for (i=0; i<20; i++) 
-                  printf("%c", msg2give.data[i]);
-               printf("\n");
-	     }
-            nsim++;
-            if (eventptr->eventity == A)
-            {
-            	A_application += 1;
-            	A_output(msg2give);
-            }  
-            /*
-             else
-               B_output(msg2give);  
-               */
-            }
-          else if (eventptr->evtype ==  FROM_LAYER3) {
-            pkt2give.seqnum = eventptr->pktptr->seqnum;
-            pkt2give.acknum = eventptr->pktptr->acknum;
-            pkt2give.checksum = eventptr->pktptr->checksum;
-            for (i=0; i<20; i++)  
-                pkt2give.payload[i] = eventptr->pktptr->payload[i];
-	    if (eventptr->eventity ==A)      /* deliver packet by calling */
-   	       A_input(pkt2give);            /* appropriate entity */
-            else
-            {
-            	B_transport += 1;
-            	B_input(pkt2give);
-            }
-	    free(eventptr->pktptr);          /* free the memory for packet */
-            }
-          else if (eventptr->evtype ==  TIMER_INTERRUPT) {
-            if (eventptr->eventity == A) 
-	       A_timerinterrupt();
-	   		/*
-             else
-	       B_timerinterrupt();
-	       	*/
-             }
-          else  {
-	     printf("INTERNAL PANIC: unknown event type \n");
-             }
-        free(eventptr);
-        }
+   /* without -P, ./gbn and the like run the protocol they are named after */
+   if (protoname == NULL && (proto = default_protocol(argv[0])) != NULL)
+      protoname = proto->name;
+   for (i=0; protoname != NULL && i < NSIMULATIONS; i++)
+      if (strcmp(simulations[i].name, protoname) == 0)
+         run = simulations[i].run;
+   if (run == NULL) {
+      fprintf(stderr, "Unknown protocol, use -P %s\n", PROTOCOL_NAMES);
+      display_usage(argv[0]);
+      return -1;
+   }
+
+   if ((ckptpath != NULL || nvariants > 0) && snapat < 0.0) {
+      fprintf(stderr, "-k and -F need a snapshot time (-x)\n");
+      return -1;
+   }
+
+   if (nthreads > 0 && (snapat >= 0.0 || restorepath != NULL ||
+                        sampleint > 0.0 || metricspath != NULL || profiling)) {
+      fprintf(stderr, "-j cannot be combined with -x, -R, -S, -M or -p\n");
+      return -1;
+   }
+
+   if (topopath != NULL && (nthreads > 0 || reorderprob > 0.0 ||
+                            ckptpath != NULL || restorepath != NULL)) {
+      fprintf(stderr, "-T cannot be combined with -j, -r, -k or -R\n");
+      return -1;
+   }
+   if (topopath != NULL && !topo_load(&topo, topopath))
+      return -1;
+
+   if (workloadpath != NULL) {
+      if (arrivaldist != ARRIVE_UNIFORM) {
+         fprintf(stderr, "-A cannot be combined with -a\n");
+         return -1;
+      }
+      if (!workload_open(&workload, workloadpath)) {
+         if (errno == EINVAL)
+            fprintf(stderr, "%s: not a workload file\n", workloadpath);
+           else
+            perror(workloadpath);
+         return -1;
+      }
+      arrivaldist = ARRIVE_REPLAY;
+      if ((uint64_t)nsimmax > workload.count) {
+         fprintf(stderr, "Warning: %s holds only %llu messages, simulating "
+                 "those\n", workloadpath, (unsigned long long)workload.count);
+         nsimmax = workload.count;
+      }
+   }
+
+   if (metricspath != NULL)
+      open_metrics(metricspath);
+   if (profiling &&
+       (profhist = (struct histogram *)calloc(NPROF, sizeof(struct histogram))) == NULL) {
+      perror("calloc");
+      return -1;
+   }
+
+   /* a restored run takes its state from the checkpoint in run() */
+   if (restorepath == NULL) {
+      if (nthreads > 0)
+         lp_init(seed);
+      init(seed);
+      nextsample = warmup + sampleint;
+      lastsampleB = 0;
+      lastsampleretx = 0;
+   }
+   profwall = wallclock();
+   profcycles = cycles();
+   run();
+   profwall = wallclock() - profwall;
+   profcycles = cycles() - profcycles;
+   if (snapat >= 0.0)
+      fprintf(stderr, "Warning: run ended before time %f, nothing was "
+              "checkpointed or forked\n", snapat);
 
-terminate:
    //Do NOT change any of the following printfs
    printf(" Simulator terminated at time %f\n after sending %d msgs from layer5\n",time_local,nsim);
 
@@ -386,6 +1815,67 @@ terminate:
    printf("[PA2]%d packets received at the Application layer of Receiver B[/PA2]\n", B_application);
    printf("[PA2]Total time: %f time units[/PA2]\n", time_local);
    printf("[PA2]Throughput: %f packets/time units[/PA2]\n", B_application/time_local);
+
+   printf("\n");
+   printf(" Message delay over %llu messages handed over after time %f:\n",
+          (unsigned long long)delayhist.total, warmup);
+   printf("  mean %f, p50 %f, p99 %f, p999 %f, max %f time units\n",
+          delayhist.total > 0 ? delayhist.sum/delayhist.total : 0.0,
+          hist_quantile(&delayhist, 0.5), hist_quantile(&delayhist, 0.99),
+          hist_quantile(&delayhist, 0.999), delayhist.max);
+   if (warmup > 0.0 && time_local > warmup)
+      printf(" Steady-state throughput after warm-up: %f packets/time units\n",
+             B_steady/(time_local - warmup));
+   printf(" Retransmissions by A: %d\n", nretransmit);
+   printf(" Bursts from A: %d, mean %f, max %d packets",
+          nbursts, nbursts > 0 ? (float)A_transport/nbursts : 0.0, maxburst);
+   if (pacing > 0)
+      printf(" (paced, at most %d back to back)", pacing);
+   printf("\n");
+   printf(" Send buffer at A: mean %f, max %d messages\n",
+          time_local > 0.0 ? occupancyarea/time_local : 0.0, maxoccupancy);
+   if (bufsize > 0)
+      printf(" Application blocked %d times for %f time units (limit %d messages)\n",
+             nblocked, blockedtime, bufsize);
+   if (nrefused > 0)
+      printf(" Messages refused by A and lost: %d\n", nrefused);
+   if (workloadpath != NULL)
+      printf(" Replayed %d of the %llu messages of %s, gaps scaled by %f\n",
+             nsim, (unsigned long long)workload.count, workloadpath, lambda);
+   if (fecblock > 0) {
+      printf(" FEC: %d parity packets per %d data packets, %d parity packets sent\n",
+             fecparity, fecblock, fec_parity_sent);
+      printf(" FEC: %d packets rebuilt at B, net %d packets saved on the link\n",
+             fec_recovered, fec_recovered - fec_parity_sent);
+      }
+   if (A_transport > 0)
+      printf(" Goodput per packet sent by A: %f\n",
+             (float)B_application/A_transport);
+   if (readtime > 0.0)
+      printf(" Unread at B: %d at the end, at most %d messages\n",
+             getunread(), maxunread);
+   if (profiling)
+      print_profile();
+   if (nthreads > 0)
+      printf(" Partitioned into %d logical processes, %ld windows of %g time units\n",
+             NLPS, nwindows, LOOKAHEAD);
+   printf(" Verified at B: %d messages delivered intact and in order, goodput %f packets/time units\n",
+          ngoodput, ngoodput/time_local);
+   printf(" Verified at B: %d duplicates, %d out of order, %d matching no message; %d gaps skipping %d messages; %d not delivered\n",
+          nduplicate, nlate, nunmatched, ngaps, nskipped,
+          nsim - nrefused - ngoodput - nlate);
+   if (topopath != NULL)
+      topo_report(&topo);
+
+   if (resultspath != NULL)
+      write_results(protoname, seed);
+
+   if (reorderprob > 0.0) {
+      printf("\n");
+      printf(" Medium displaced %d of %d packets\n", nreordered, ntolayer3);
+      printf(" Out of order deliveries: %d at A, %d at B\n",
+             noutoforder[A], noutoforder[B]);
+      }
    return 0;
 }
 
@@ -423,9 +1913,11 @@ terminate:
 void printevlist()
 {
   struct event *q;
-  int i;
+  evidx i;
   printf("--------------\nEvent List Follows:\n");
-  for(q = evlist; q!=NULL; q=q->next) {
+  printf("Next arrival time: %f, entity: %d\n",arrival.evtime,arrival.eventity);
+  for(i = evlist; i!=EVNIL; i=q->next) {
+    q = eventat(i);
     printf("Event time: %f, type: %d entity: %d\n",q->evtime,q->evtype,q->eventity);
     }
   printf("--------------\n");
@@ -439,29 +1931,27 @@ void printevlist()
 void stoptimer(int AorB)
  //AorB;  /* A or B is trying to stop timer */
 {
- struct event *q,*qold;
+ struct event *q;
+ evidx i;
+ PROFILE(PROF_STOPTIMER);
 
  if (TRACE>2)
     printf("          STOP TIMER: stopping timer at %f\n",time_local);
-/* for (q=evlist; q!=NULL && q->next!=NULL; q = q->next)  */
- for (q=evlist; q!=NULL ; q = q->next) 
+ for (i=evlist; i!=EVNIL ; i = q->next) {
+    q = eventat(i);
     if ( (q->evtype==TIMER_INTERRUPT  && q->eventity==AorB) ) { 
        /* remove this event */
-       if (q->next==NULL && q->prev==NULL)
-             evlist=NULL;         /* remove first and only event on list */
-          else if (q->next==NULL) /* end of list - there is one in front */
-             q->prev->next = NULL;
-          else if (q==evlist) { /* front of list - there must be event after */
-             q->next->prev=NULL;
-             evlist = q->next;
-             }
-           else {     /* middle of list */
-             q->next->prev = q->prev;
-             q->prev->next =  q->next;
-             }
-       free(q);
+       if (q->next != EVNIL)
+          eventat(q->next)->prev = q->prev;
+       if (q->prev != EVNIL)
+          eventat(q->prev)->next = q->next;
+         else
+          evlist = q->next;       /* front of list */
+       freeevent(i);
+       nevlist--;
        return;
      }
+    }
   printf("Warning: unable to cancel your timer. It wasn't running.\n");
 }
 
@@ -473,24 +1963,27 @@ void starttimer(int AorB,float increment)
 
  struct event *q;
  struct event *evptr;
- ////char *malloc();
+ evidx i;
+ PROFILE(PROF_STARTTIMER);
 
  if (TRACE>2)
     printf("          START TIMER: starting timer at %f\n",time_local);
  /* be nice: check to see if timer is already started, if so, then  warn */
-/* for (q=evlist; q!=NULL && q->next!=NULL; q = q->next)  */
-   for (q=evlist; q!=NULL ; q = q->next)  
+   for (i=evlist; i!=EVNIL ; i = q->next) {
+    q = eventat(i);
     if ( (q->evtype==TIMER_INTERRUPT  && q->eventity==AorB) ) { 
       printf("Warning: attempt to start a timer that is already started\n");
       return;
       }
+    }
  
 /* create future event for when timer goes off */
-   evptr = (struct event *)malloc(sizeof(struct event));
+   i = newevent();
+   evptr = eventat(i);
    evptr->evtime =  time_local + increment;
    evptr->evtype =  TIMER_INTERRUPT;
    evptr->eventity = AorB;
-   insertevent(evptr);
+   insertevent(i);
 } 
 
 
@@ -498,18 +1991,30 @@ void starttimer(int AorB,float increment)
 void tolayer3(int AorB,struct pkt packet)
 {
  struct pkt *mypktptr;
- struct event *evptr,*q;
- ////char *malloc();
- float lastime, x, jimsrand();
+ struct event *evptr;
+ evidx id;
+ PROFILE(PROF_TOLAYER3);
+ float lastime, jimsrand();
  int i;
 
 
  ntolayer3++;
 
- if(AorB == 0) A_transport += 1;
+ if(AorB == 0) {
+    A_transport += 1;
+    if (track_pkt_sent(packet.payload))
+       nretransmit++;
+    if (time_local != bursttime) {
+       bursttime = time_local;
+       burstlen_now = 0;
+       nbursts++;
+       }
+    if (++burstlen_now > maxburst)
+       maxburst = burstlen_now;
+    }
 
- /* simulate losses: */
- if (jimsrand() < lossprob)  {
+ /* simulate losses (on each link instead, with -T): */
+ if (topopath == NULL && jimsrand() < lossprob)  {
       nlost++;
       if (TRACE>0)    
 	printf("          TOLAYER3: packet being lost\n");
@@ -518,7 +2023,9 @@ void tolayer3(int AorB,struct pkt packet)
 
 /* make a copy of the packet student just gave me since he/she may decide */
 /* to do something with the packet after we return back to him/her */ 
- mypktptr = (struct pkt *)malloc(sizeof(struct pkt));
+ id = newevent();
+ evptr = eventat(id);
+ mypktptr = &evptr->pkt;
  mypktptr->seqnum = packet.seqnum;
  mypktptr->acknum = packet.acknum;
  mypktptr->checksum = packet.checksum;
@@ -532,53 +2039,74 @@ void tolayer3(int AorB,struct pkt packet)
     printf("\n");
    }
 
+ if (topopath != NULL) {
+    send_routed(AorB, id);
+    return;
+    }
+
 /* create future event for arrival of packet at the other side */
-  evptr = (struct event *)malloc(sizeof(struct event));
   evptr->evtype =  FROM_LAYER3;   /* packet will pop out from layer3 */
   evptr->eventity = (AorB+1) % 2; /* event occurs at other entity */
-  evptr->pktptr = mypktptr;       /* save ptr to my copy of packet */
 /* finally, compute the arrival time of packet at the other end.
-   medium can not reorder, so make sure packet arrives between 1 and 10
-   time units after the latest arrival time of packets
-   currently in the medium on their way to the destination */
+   a FIFO medium can not reorder, so make sure packet arrives between 1 and
+   10 time units after the latest arrival time of packets currently in the
+   medium on their way to the destination. lastarrival[] tracks that time
+   so we need not walk the event list. a displaced packet is held back
+   further and does not push back the packets sent after it. */
  lastime = time_local;
-/* for (q=evlist; q!=NULL && q->next!=NULL; q = q->next) */
- for (q=evlist; q!=NULL ; q = q->next) 
-    if ( (q->evtype==FROM_LAYER3  && q->eventity==evptr->eventity) ) 
-      lastime = q->evtime;
+ if (lastarrival[evptr->eventity] > lastime)
+    lastime = lastarrival[evptr->eventity];
  evptr->evtime =  lastime + 1 + 9*jimsrand();
- 
-
+ if (reorderprob > 0.0 && jimsrand() < reorderprob) {
+    nreordered++;
+    if (reorderdist == DISP_EXP)
+       evptr->evtime += -reorderdisp*log(1.0 - jimsrand()*0.999999);
+      else
+       evptr->evtime += 2*reorderdisp*jimsrand();
+    if (TRACE>0)
+	printf("          TOLAYER3: packet being displaced\n");
+    }
+   else
+    lastarrival[evptr->eventity] = evptr->evtime;
+ evptr->sendidx = ++nsent3[evptr->eventity];
 
  /* simulate corruption: */
- if (jimsrand() < corruptprob)  {
-    ncorrupt++;
-    if ( (x = jimsrand()) < .75)
-       mypktptr->payload[0]='Z';   /* corrupt payload */
-      else if (x < .875)
-       mypktptr->seqnum = 999999;
-      else
-       mypktptr->acknum = 999999;
-    if (TRACE>0)    
-	printf("          TOLAYER3: packet being corrupted\n");
-    }  
+ if (jimsrand() < corruptprob)
+    corrupt_packet(mypktptr);
 
   if (TRACE>2)  
      printf("          TOLAYER3: scheduling arrival on other side\n");
-  insertevent(evptr);
+  ninflight++;
+  if (curlp != NULL)         /* the other LP's, in a partitioned run */
+     post(id);
+    else
+     insertevent(id);
 } 
 
 void tolayer5(int AorB,char *datasent)
 {
   
   int i;  
+  PROFILE(PROF_TOLAYER5);
   if (TRACE>2) {
      printf("          TOLAYER5: data received: ");
      for (i=0; i<20; i++)  
         printf("%c",datasent[i]);
      printf("\n");
    }
-  if(AorB == 1) B_application += 1;
+  if(AorB == 1) {
+     B_application += 1;
+     if (readtime > 0.0) {
+        if (getunread() == 0)
+           nextread = time_local + readtime*2*erand48(readrng);
+        if (++nunread > maxunread)
+           maxunread = nunread;
+        }
+     if (curlp != NULL)      /* A matches it, in a partitioned run */
+        log_delivery(datasent);
+       else
+        match_delivery(datasent, time_local);
+     }
 }
 
 int getwinsize()
@@ -586,6 +2114,35 @@ int getwinsize()
 	return win_size;
 }
 
+int getbufsize()
+{
+	return bufsize;
+}
+
+/* messages B's application has yet to read, as of now */
+int getunread()
+{
+	while (nunread > 0 && nextread <= time_local)
+		if (--nunread > 0)
+			nextread += readtime*2*erand48(readrng);
+	return nunread;
+}
+
+int getfecblock()
+{
+	return fecblock;
+}
+
+int getfecparity()
+{
+	return fecparity;
+}
+
+int getpacing()
+{
+	return pacing;
+}
+
 float get_sim_time()
 {
 	return time_local;
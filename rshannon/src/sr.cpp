@@ -1,6 +1,8 @@
 #include "../include/packet.h"
 #include "../include/sr.h"
 #include "../include/simulator.h"
+#include "../include/protocol.h"
+#include "../include/checkpoint.h"
 #include <cstring>
 #include <iostream>
 #include <iterator>
@@ -14,6 +16,22 @@
     }                                                                          \
   } while (0) // http://stackoverflow.com/questions/14251038/debug-macros-in-c
 
+namespace sr {
+
+/* Protocol state, documented in sr.h */
+std::vector<pkt_timer> pkt_timers;
+std::deque<struct pkt> unacked_buf;
+std::deque<struct pkt> unsent_buf;
+float timer_interval;
+std::vector<pkt> recv_buf;
+int send_base;
+int next_seq_num;
+int window_size;
+int recv_base;
+int rwnd;
+struct fec_encoder fec_tx;
+struct fec_decoder fec_rx;
+
 /**
  * Create a new packet timer.
  *
@@ -178,9 +196,16 @@ pkt make_pkt(int seqnum, int acknum, struct msg message) {
   return packet;
 }
 
+/**
+ * Room left in B's receive buffer, which holds window_size messages
+ * including those delivered that its application has not read yet.
+ */
+int receive_room() { return std::max(window_size - getunread(), 0); }
+
 /**
  * Construct an ACK. This differs from make_pkt
- * in that it does not create a new packet timer.
+ * in that it does not create a new packet timer,
+ * and carries the room B has left as its payload.
  *
  * @param  seqnum the sequence number of the packet
  * @param  acknum the ack number of the packet
@@ -190,6 +215,8 @@ pkt make_pkt(int seqnum, int acknum, struct msg message) {
 pkt make_ack_pkt(int seqnum, int acknum) {
   struct pkt packet = {}; // Initialize packet and zero fill members
   struct msg ack_msg = {};
+  int room = receive_room();
+  memcpy(ack_msg.data, &room, sizeof(room));
   packet.seqnum = seqnum;
   packet.acknum = acknum;
   strncpy(packet.payload, ack_msg.data, MSG_LEN);
@@ -211,6 +238,24 @@ void send_pkt(int caller, struct pkt packet) {
   start_pkt_timer(packet.seqnum);
 }
 
+/**
+ * Send a packet for the first time, followed by its block's parity
+ * packets if it completes one. Parity packets have no timers; a block
+ * is only ever protected once.
+ *
+ * @param packet the packet to send
+ */
+void send_new_pkt(struct pkt packet) {
+  struct pkt parity[FEC_MAX_PARITY];
+  send_pkt(0, packet);
+  int n = fec_encode(&fec_tx, packet, parity);
+  for (int i = 0; i < n; i++) {
+    parity[i].checksum = checksum(parity[i]);
+    DEBUG("sender: sent parity " << i << " of block at " << parity[i].seqnum);
+    tolayer3(0, parity[i]);
+  }
+}
+
 /**
  * Take a packet structure and calculate
  * its checksum by adding up each 8 bit chunk
@@ -253,16 +298,12 @@ bool is_corrupt(struct pkt packet) {
 }
 
 /**
- * Add unacknowledged packet to buffer.
+ * Add unacknowledged packet to buffer. Packets are only sent within the
+ * window, so this never holds more than window_size packets.
  *
  * @param packet the unacknowledged packet
  */
 void add_to_unacked_buf(struct pkt packet) {
-  if (unacked_buf.size() == MAX_BUF_SIZE) {
-    // Enforce maximum buffer size of MAX_BUF_SIZE
-    // If the buffer fills up, drop the oldest packet.
-    unacked_buf.pop_back();
-  }
   // Queue packet
   DEBUG("sender: adding packet " << packet.seqnum << " to unacked buffer");
   unacked_buf.push_back(packet);
@@ -277,7 +318,9 @@ void add_to_unacked_buf(struct pkt packet) {
 void add_to_unsent_buf(struct pkt packet) {
   if (unsent_buf.size() == MAX_BUF_SIZE) {
     // Enforce maximum buffer size of MAX_BUF_SIZE
-    // If the buffer fills up, drop the oldest packet.
+    // If the buffer fills up, drop the oldest packet, which has not been
+    // sent yet, and its timer.
+    destroy_pkt_timer(unsent_buf.front().seqnum);
     unsent_buf.pop_front();
   }
   // Queue packet
@@ -286,16 +329,37 @@ void add_to_unsent_buf(struct pkt packet) {
   DEBUG("sender: unsent buffer has size " << unsent_buf.size());
 }
 
+/**
+ * The most packets A may have outstanding: its own window, or less if B
+ * has advertised less room.
+ */
+int usable_window() { return std::min(window_size, rwnd); }
+
+/**
+ * The messages A is holding, sent or waiting for the window.
+ */
+int backlog() { return unacked_buf.size() + unsent_buf.size(); }
+
 /**
  * Called when an application has a message ready to sent
- * out through the network.
+ * out through the network. If the emulator gave A a send buffer the
+ * message is refused, before it takes a sequence number or a timer,
+ * once A holds that many messages or MAX_NO_TIMERS (each one needs a
+ * timer). Otherwise the unsent buffer drops its oldest packet once it
+ * holds MAX_BUF_SIZE.
  *
  * @param message the message to send
+ * @return        false if the message was not taken
  */
-void A_output(struct msg message) {
+bool A_output(struct msg message) {
+  if (getbufsize() > 0 &&
+      (backlog() >= getbufsize() || pkt_timers.size() >= MAX_NO_TIMERS)) {
+    DEBUG("sender: send buffer full, refusing message");
+    return false;
+  }
   struct pkt packet = make_pkt(next_seq_num, 0, message);
-  if (next_seq_num < send_base + window_size) {
-    send_pkt(0, packet);
+  if (next_seq_num < send_base + usable_window()) {
+    send_new_pkt(packet);
     // Buffer unacknowledged packet
     add_to_unacked_buf(packet);
   } else {
@@ -303,10 +367,12 @@ void A_output(struct msg message) {
     add_to_unsent_buf(packet);
   }
   next_seq_num++;
+  return true;
 }
 
 /**
- * Called when host A received a packet from the network.
+ * Called when host A received a packet from the network. Every ACK
+ * carries the room B has left, which caps the window from then on.
  *
  * @param packet the packet received from the network
  */
@@ -316,17 +382,7 @@ void A_input(struct pkt packet) {
     return;
   }
   DEBUG("sender: received ack " << packet.acknum);
-
-  // Update send_base
-  std::sort(unacked_buf.begin(), unacked_buf.end(), sort_by_seq);
-  if (unacked_buf[0].seqnum == packet.acknum) {
-    if (unacked_buf.size() > 1) {
-      send_base = unacked_buf[1].seqnum;
-    } else {
-      send_base++;
-    }
-  }
-  DEBUG("BASE updated to " << send_base);
+  memcpy(&rwnd, packet.payload, sizeof(rwnd));
 
   // Mark packet as received
   int i;
@@ -342,9 +398,21 @@ void A_input(struct pkt packet) {
     unacked_buf.erase(unacked_buf.begin() + i);
   }
 
+  // Update send_base to the oldest packet not yet acknowledged. Packets
+  // can be acknowledged in any order, so this is not simply the next one.
+  std::sort(unacked_buf.begin(), unacked_buf.end(), sort_by_seq);
+  if (!unacked_buf.empty()) {
+    send_base = unacked_buf[0].seqnum;
+  } else if (!unsent_buf.empty()) {
+    send_base = unsent_buf.front().seqnum;
+  } else {
+    send_base = next_seq_num;
+  }
+  DEBUG("BASE updated to " << send_base);
+
   // Send queued packets if there is space available in the window
   int free_to_send =
-      window_size -
+      usable_window() -
       unacked_buf.size(); // The number of new packets that can be sent
   int avail_to_send =
       unsent_buf.size(); // The number of queued packet available to be sent
@@ -357,7 +425,7 @@ void A_input(struct pkt packet) {
     }
     struct pkt packet = unsent_buf.front();
     unsent_buf.pop_front();
-    send_pkt(0, packet);
+    send_new_pkt(packet);
     // Buffer unacknowledged packet
     add_to_unacked_buf(packet);
   }
@@ -373,11 +441,23 @@ bool sort_by_seq(const pkt &a, const pkt &b) { return a.seqnum < b.seqnum; }
  * Called whenever a "hardware" timer interrupt occurs.
  * (Note that within a simulated environment like this
  * there is no true hardware timer present.)
+ *
+ * If B has closed its window and nothing is outstanding, no ACK will
+ * come to reopen it, so the next waiting packet is sent anyway as a
+ * probe; its packet timer keeps probing until B has room for it.
  */
 void A_timerinterrupt() {
   // Fire all expired packet timers
   fire_expired_pkt_timers();
 
+  if (rwnd <= 0 && unacked_buf.empty() && !unsent_buf.empty()) {
+    struct pkt packet = unsent_buf.front();
+    DEBUG("sender: probing closed window with " << packet.seqnum);
+    unsent_buf.pop_front();
+    send_new_pkt(packet);
+    add_to_unacked_buf(packet);
+  }
+
   // Restart hardware timer
   starttimer(0, 1.0);
 }
@@ -389,6 +469,8 @@ void A_init() {
   send_base = 1;
   next_seq_num = 1;
   window_size = getwinsize();
+  rwnd = window_size;
+  fec_encoder_init(&fec_tx, getfecblock(), getfecparity());
   // Start hardware timer
   starttimer(0, 1.0);
 }
@@ -399,11 +481,31 @@ void A_init() {
  * @param packet the packet from the network
  */
 void B_input(struct pkt packet) {
+  struct pkt recovered[FEC_MAX_PARITY];
+
   // Check if packet is corrupt
   if (is_corrupt(packet)) {
     DEBUG("receiver: packet received but corrupted");
     return;
   }
+  int n = fec_decode(&fec_rx, packet, recovered);
+  if (!fec_is_parity(packet)) {
+    B_receive(packet);
+  }
+  for (int i = 0; i < n; i++) {
+    DEBUG("receiver: rebuilt packet " << recovered[i].seqnum << " from parity");
+    recovered[i].checksum = checksum(recovered[i]);
+    B_receive(recovered[i]);
+  }
+}
+
+/**
+ * Receiver side handling of an intact data packet, whether it came from
+ * the network or was rebuilt from parity.
+ *
+ * @param packet the data packet
+ */
+void B_receive(struct pkt packet) {
 
   // Check if packet already received
   for (int i = 0; i < recv_buf.size(); i++) {
@@ -416,6 +518,15 @@ void B_input(struct pkt packet) {
     }
   }
 
+  // No room for the packet yet: drop it, and answer with a duplicate ACK
+  // of the last one delivered so the sender hears how much room there is
+  if (packet.seqnum >= recv_base + receive_room() &&
+      packet.seqnum < recv_base + window_size) {
+    DEBUG("receiver: no room for packet " << packet.seqnum);
+    tolayer3(1, make_ack_pkt(recv_base - 1, recv_base - 1));
+    return;
+  }
+
   // Packet is within receiver window
   if (packet.seqnum >= recv_base && packet.seqnum < recv_base + window_size) {
     // Send acknowledgement
@@ -462,13 +573,74 @@ void B_input(struct pkt packet) {
       recv_buf.push_back(packet);
     }
   }
-  // Send acknowledgement
+  // Send acknowledgement. This goes straight to the network rather than
+  // through send_pkt, which would (re)start the sender's packet timer
+  // for this sequence number from the receiver side.
   struct pkt ack_pkt = make_ack_pkt(packet.seqnum, packet.seqnum);
   DEBUG("receiver: packet received, sending ack " << packet.seqnum);
-  send_pkt(1, ack_pkt);
+  tolayer3(1, ack_pkt);
 }
 
 /**
  * Initialization for receiver once simulation begins.
  */
-void B_init() { recv_base = 1; }
+void B_init() {
+  recv_base = 1;
+  // The receiver window is the same size as the sender's, but B may run
+  // apart from A (e.g. in its own process), so it cannot rely on A_init.
+  window_size = getwinsize();
+  fec_decoder_init(&fec_rx, getfecblock(), getfecparity());
+}
+
+
+/**
+ * Write the protocol state to a checkpoint.
+ *
+ * @param f the checkpoint file
+ */
+void save_state(FILE *f) {
+  ckpt_put_seq(f, pkt_timers);
+  ckpt_put_seq(f, unacked_buf);
+  ckpt_put_seq(f, unsent_buf);
+  ckpt_put(f, timer_interval);
+  ckpt_put_seq(f, recv_buf);
+  ckpt_put(f, send_base);
+  ckpt_put(f, next_seq_num);
+  ckpt_put(f, window_size);
+  ckpt_put(f, recv_base);
+  ckpt_put(f, rwnd);
+  ckpt_put(f, fec_tx);
+  ckpt_put(f, fec_rx.k);
+  ckpt_put(f, fec_rx.r);
+  ckpt_put_seq(f, fec_rx.blocks);
+}
+
+/**
+ * Read back the protocol state written by save_state.
+ *
+ * @param  f the checkpoint file
+ * @return   false if the checkpoint is truncated
+ */
+bool load_state(FILE *f) {
+  return ckpt_get_seq(f, pkt_timers) && ckpt_get_seq(f, unacked_buf) &&
+         ckpt_get_seq(f, unsent_buf) && ckpt_get(f, timer_interval) &&
+         ckpt_get_seq(f, recv_buf) && ckpt_get(f, send_base) &&
+         ckpt_get(f, next_seq_num) && ckpt_get(f, window_size) &&
+         ckpt_get(f, recv_base) && ckpt_get(f, rwnd) &&
+         ckpt_get(f, fec_tx) &&
+         ckpt_get(f, fec_rx.k) && ckpt_get(f, fec_rx.r) &&
+         ckpt_get_seq(f, fec_rx.blocks);
+}
+
+/**
+ * Called when the emulator's parameters change mid-run. The sender and
+ * receiver windows both follow getwinsize(); a smaller window takes
+ * effect as the packets already outstanding are acknowledged. A new FEC
+ * block size starts both sides afresh.
+ */
+void reconfigure() {
+  window_size = getwinsize();
+  fec_reconfigure(&fec_tx, &fec_rx, getfecblock(), getfecparity());
+}
+
+} // namespace sr
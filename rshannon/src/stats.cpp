@@ -0,0 +1,193 @@
+#include <deque>
+#include <unordered_map>
+
+#include "../include/simulator.h"
+#include "../include/packet.h"
+#include "../include/stats.h"
+#include "../include/checkpoint.h"
+
+/**
+ * Bucket index of a scaled value.
+ */
+static int hist_index(uint64_t v) {
+  if (v < HIST_SUB) {
+    return (int)v;
+  }
+  int shift = 63 - __builtin_clzll(v) - (HIST_SUB_BITS - 1);
+  return HIST_SUB + (shift - 1) * (HIST_SUB / 2) +
+         (int)((v >> shift) - HIST_SUB / 2);
+}
+
+/**
+ * Midpoint of the range of scaled values that land in a bucket.
+ */
+static double hist_value(int index) {
+  if (index < HIST_SUB) {
+    return index;
+  }
+  int shift = (index - HIST_SUB) / (HIST_SUB / 2) + 1;
+  uint64_t m = (index - HIST_SUB) % (HIST_SUB / 2) + HIST_SUB / 2;
+  return ((m << shift) + ((m + 1) << shift) - 1) / 2.0;
+}
+
+void hist_record(struct histogram *h, double value) {
+  if (value < 0) {
+    value = 0;
+  }
+  h->counts[hist_index((uint64_t)(value * HIST_SCALE))]++;
+  h->total++;
+  h->sum += value;
+  if (value > h->max) {
+    h->max = value;
+  }
+}
+
+double hist_quantile(const struct histogram *h, double q) {
+  if (h->total == 0) {
+    return 0.0;
+  }
+  uint64_t rank = (uint64_t)(q * h->total);
+  if (rank >= h->total) {
+    rank = h->total - 1;
+  }
+  uint64_t seen = 0;
+  for (int i = 0; i < HIST_BUCKETS; i++) {
+    seen += h->counts[i];
+    if (seen > rank) {
+      double v = hist_value(i) / HIST_SCALE;
+      return v < h->max ? v : h->max;
+    }
+  }
+  return h->max;
+}
+
+/* Where a message is */
+#define MSG_OUTSTANDING 0 // With A or in the medium
+#define MSG_DELIVERED 1
+#define MSG_SKIPPED 2     // Outstanding when B delivered a later one
+#define MSG_NEVER 3       // Never handed to A, or refused by it
+
+/**
+ * A message handed to A.
+ */
+struct msg_record {
+  float sent;       // When it was handed to A
+  uint64_t hash;    // Hash of its payload
+  bool transmitted; // Whether A has put it on the wire yet
+  char state;       // MSG_ constant
+};
+
+// Remembered messages, by number: the outstanding ones and up to
+// TRACK_HISTORY before them. Every message before next_id is delivered,
+// skipped or never handed over, and every one from it on outstanding.
+static std::deque<msg_record> records;
+static int first_id = 0; // Number of records.front()
+static int next_id = 0;  // Message B should deliver next
+static std::unordered_map<uint64_t, int> by_hash;
+
+static uint64_t payload_hash(const char *data) {
+  uint64_t h = 14695981039346656037ULL; // 64-bit FNV-1a
+  for (int i = 0; i < MSG_LEN; i++) {
+    h ^= (unsigned char)data[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+void track_msg_sent(int id, float time, const char *data) {
+  if (records.empty()) {
+    first_id = next_id = id;
+  }
+  while (first_id + (int)records.size() < id) {
+    msg_record gap = {time, 0, false, MSG_NEVER}; // Never matches
+    records.push_back(gap);
+  }
+  msg_record r = {time, payload_hash(data), false, MSG_OUTSTANDING};
+  records.push_back(r);
+  by_hash[r.hash] = id;
+}
+
+void track_msg_refused(int id) {
+  if (id >= first_id && id < first_id + (int)records.size()) {
+    records[id - first_id].state = MSG_NEVER;
+  }
+}
+
+/**
+ * Look up the remembered message carrying data.
+ */
+static int find(const char *data) {
+  std::unordered_map<uint64_t, int>::iterator it =
+      by_hash.find(payload_hash(data));
+  if (it == by_hash.end() || it->second < first_id) {
+    return -1;
+  }
+  return it->second;
+}
+
+bool track_pkt_sent(const char *payload) {
+  int id = find(payload);
+  if (id < next_id) { // Done with, as far as B is concerned
+    return false;
+  }
+  msg_record &r = records[id - first_id];
+  bool again = r.transmitted;
+  r.transmitted = true;
+  return again;
+}
+
+int track_msg_delivered(const char *data, float *sent, int *skipped) {
+  int id = find(data);
+  if (id < 0) {
+    return DELIVERY_UNMATCHED;
+  }
+  msg_record &r = records[id - first_id];
+  switch (r.state) {
+  case MSG_DELIVERED: return DELIVERY_DUPLICATE;
+  case MSG_SKIPPED: r.state = MSG_DELIVERED; return DELIVERY_LATE;
+  case MSG_NEVER: return DELIVERY_UNMATCHED;
+  }
+  *sent = r.sent;
+  *skipped = 0;
+  for (; next_id < id; next_id++) {
+    msg_record &s = records[next_id - first_id];
+    if (s.state == MSG_OUTSTANDING) {
+      s.state = MSG_SKIPPED;
+      (*skipped)++;
+    }
+  }
+  r.state = MSG_DELIVERED;
+  next_id++;
+  // Forget the oldest to keep the table bounded
+  while (next_id - first_id > TRACK_HISTORY) {
+    std::unordered_map<uint64_t, int>::iterator it =
+        by_hash.find(records.front().hash);
+    if (it != by_hash.end() && it->second == first_id) {
+      by_hash.erase(it);
+    }
+    records.pop_front();
+    first_id++;
+  }
+  return *skipped > 0 ? DELIVERY_GAP : DELIVERY_INORDER;
+}
+
+void track_save(FILE *f) {
+  ckpt_put(f, first_id);
+  ckpt_put(f, next_id);
+  ckpt_put_seq(f, records);
+}
+
+bool track_load(FILE *f) {
+  if (!ckpt_get(f, first_id) || !ckpt_get(f, next_id) ||
+      !ckpt_get_seq(f, records)) {
+    return false;
+  }
+  // Rebuild the index; gaps were never in it
+  by_hash.clear();
+  for (size_t i = 0; i < records.size(); i++) {
+    if (records[i].hash != 0) {
+      by_hash[records[i].hash] = first_id + i;
+    }
+  }
+  return true;
+}
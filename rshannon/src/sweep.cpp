@@ -0,0 +1,898 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <ctype.h>
+#include <getopt.h>
+#include <math.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../include/results.h"
+
+/*
+ * Parameter-sweep driver.
+ *
+ * Reads a grid spec, expands it into cells (one simulator run each),
+ * runs the cells that are not already cached across all cores, and
+ * writes one CSV and one binary results file (see results.h) per grid.
+ * A spec looks like:
+ *
+ *   # defaults for every grid below
+ *   messages = 1000
+ *   corrupt  = 0.2
+ *   time     = 50
+ *   seeds    = 10
+ *
+ *   [exp1-abt]
+ *   protocol = abt
+ *   loss     = 0.1 0.2 0.4 0.6 0.8
+ *   window   = 10
+ *
+ * Every key takes a list of values and the grid is their cross product;
+ * `seeds = n` runs seeds 1..n. Keys: protocol, loss, corrupt, time,
+ * window, messages, seeds, output (defaults to <grid>.csv), ci,
+ * max_seeds. A spec with no [sections] is a single grid named "sweep".
+ *
+ * With `ci = h` replicates are added sequentially: once a configuration's
+ * first `seeds` runs are in, more seeds are run until the 95% confidence
+ * interval of its mean throughput has a half-width of at most h (or h% of
+ * the mean, with `ci = h%`) or `max_seeds` (default 100) have been run.
+ * Quiet configurations stop after a handful of runs while noisy ones get
+ * as many as they need. <grid>-summary.csv reports, per configuration,
+ * the replicates run and the interval achieved.
+ *
+ * Every cell runs the multi-protocol rdt binary with -P, so one grid can
+ * mix protocols. Runs report through the emulator's -o binary results
+ * output rather than stdout. Each completed cell is cached under the cache
+ * directory keyed by a hash of its command line and of the binary's
+ * contents, so a re-run only computes cells that are new or whose binary
+ * has been rebuilt.
+ *
+ * Regression checks. `-U baseline.csv` records, per configuration, the
+ * mean and standard deviation over its seeds of the simulated throughput
+ * and of the emulator's speed in events per second of wall time.
+ * `-B baseline.csv` reruns the grids and compares against such a file
+ * with Welch's t-test: a configuration whose throughput is significantly
+ * lower, or whose speed is significantly lower by more than the -e
+ * tolerance (default 10%), is flagged, and the exit status is 1. Both
+ * bypass the cache so that the speed is measured afresh; compare runs
+ * made with the same -j on the same machine.
+ */
+
+/**
+ * One simulator run.
+ */
+struct cell {
+  std::string grid;
+  std::string protocol;
+  std::string loss, corrupt, time, window, messages;
+  int seed;
+  std::string key;    // Cache key
+  bool done;          // Whether row holds the run's results
+  struct result_row row;
+};
+
+/**
+ * One configuration: the cells that differ only by seed.
+ */
+struct point {
+  std::vector<size_t> cells; // Indices into the cell list
+  int outstanding;           // Cells pending or running
+  double target;             // CI half-width to reach, 0 for fixed seeds
+  bool relative;             // Whether target is a fraction of the mean
+  int max_seeds;             // Replicate cap
+  bool finished;             // Whether no more seeds will be added
+  // Throughput over the successful runs, once finished
+  int n;
+  double mean, half_width;
+};
+
+/**
+ * One grid from the spec.
+ */
+struct grid {
+  std::string name;
+  std::map<std::string, std::vector<std::string> > keys;
+};
+
+static const char *bindir = ".";        // -b where rdt lives
+static const char *cachedir = ".sweep-cache"; // -C
+static int jobs = 0;                     // -j, 0 means one per core
+static const char *baseline_in = NULL;   // -B baseline to compare against
+static const char *baseline_out = NULL;  // -U baseline to write
+static double speed_tolerance = 0.10;    // -e smallest slowdown flagged
+
+static std::string binary_hash; // Hash of rdt, once read
+
+static void usage(char *filename) {
+  fprintf(stderr, "Usage:\n %s [-j Jobs] [-b Simulator binary directory] "
+                  "[-C Cache directory] [-B Baseline to compare against] "
+                  "[-U Baseline to write] [-e Speed tolerance] spec\n",
+          filename);
+}
+
+/**
+ * 64-bit FNV-1a, continuing from h.
+ */
+static unsigned long long fnv1a(const void *data, size_t len,
+                                unsigned long long h) {
+  const unsigned char *p = (const unsigned char *)data;
+  for (size_t i = 0; i < len; i++) {
+    h ^= p[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+static std::string hex(unsigned long long h) {
+  char buf[17];
+  snprintf(buf, sizeof(buf), "%016llx", h);
+  return buf;
+}
+
+static std::string binary_path() { return std::string(bindir) + "/rdt"; }
+
+/**
+ * Hash of the simulator binary's contents, so a rebuild misses the cache.
+ */
+static const std::string &binary_version() {
+  if (!binary_hash.empty()) {
+    return binary_hash;
+  }
+  std::string path = binary_path();
+  FILE *f = fopen(path.c_str(), "rb");
+  if (f == NULL) {
+    fprintf(stderr, "Unable to read simulator binary %s\n", path.c_str());
+    exit(-1);
+  }
+  unsigned long long h = 14695981039346656037ULL;
+  char buf[65536];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+    h = fnv1a(buf, n, h);
+  }
+  fclose(f);
+  return binary_hash = hex(h);
+}
+
+static std::vector<std::string> split(const std::string &s) {
+  std::vector<std::string> words;
+  size_t i = 0;
+  while (i < s.size()) {
+    while (i < s.size() && (isspace(s[i]) || s[i] == ',')) {
+      i++;
+    }
+    size_t j = i;
+    while (j < s.size() && !isspace(s[j]) && s[j] != ',') {
+      j++;
+    }
+    if (j > i) {
+      words.push_back(s.substr(i, j - i));
+    }
+    i = j;
+  }
+  return words;
+}
+
+/**
+ * Parse a spec file into grids. Top-level keys are defaults for every grid.
+ */
+static std::vector<grid> read_spec(const char *path) {
+  std::vector<grid> grids;
+  grid defaults;
+  grid *current = &defaults;
+  char line[1024];
+  int lineno = 0;
+
+  FILE *f = fopen(path, "r");
+  if (f == NULL) {
+    perror(path);
+    exit(-1);
+  }
+  while (fgets(line, sizeof(line), f) != NULL) {
+    lineno++;
+    std::string s(line);
+    size_t hash = s.find('#');
+    if (hash != std::string::npos) {
+      s.erase(hash);
+    }
+    std::vector<std::string> words = split(s);
+    if (words.empty()) {
+      continue;
+    }
+    if (s.find('[') != std::string::npos) {
+      size_t open = s.find('['), close = s.find(']');
+      if (close == std::string::npos || close < open) {
+        fprintf(stderr, "%s:%d: malformed section\n", path, lineno);
+        exit(-1);
+      }
+      grid g = defaults;
+      g.name = s.substr(open + 1, close - open - 1);
+      grids.push_back(g);
+      current = &grids.back();
+      continue;
+    }
+    size_t eq = s.find('=');
+    if (eq == std::string::npos) {
+      fprintf(stderr, "%s:%d: expected key = values\n", path, lineno);
+      exit(-1);
+    }
+    std::vector<std::string> key = split(s.substr(0, eq));
+    if (key.size() != 1) {
+      fprintf(stderr, "%s:%d: malformed key\n", path, lineno);
+      exit(-1);
+    }
+    current->keys[key[0]] = split(s.substr(eq + 1));
+  }
+  fclose(f);
+  if (grids.empty()) {
+    defaults.name = "sweep";
+    grids.push_back(defaults);
+  }
+  return grids;
+}
+
+static const std::vector<std::string> &require(grid &g, const char *key) {
+  if (g.keys[key].empty()) {
+    fprintf(stderr, "Grid [%s] is missing a value for '%s'\n", g.name.c_str(),
+            key);
+    exit(-1);
+  }
+  return g.keys[key];
+}
+
+/**
+ * A cell of a configuration with the given seed, copied from another.
+ */
+static cell with_seed(const cell &x, int seed) {
+  cell y = x;
+  y.seed = seed;
+  y.done = false;
+  return y;
+}
+
+/**
+ * Expand a grid into its configurations and their initial cells.
+ */
+static void expand(grid &g, std::vector<point> &points,
+                   std::vector<cell> &cells) {
+  const std::vector<std::string> &protocols = require(g, "protocol");
+  const std::vector<std::string> &losses = require(g, "loss");
+  const std::vector<std::string> &corrupts = require(g, "corrupt");
+  const std::vector<std::string> &times = require(g, "time");
+  const std::vector<std::string> &windows = require(g, "window");
+  const std::vector<std::string> &messages = require(g, "messages");
+  int seeds = atoi(require(g, "seeds")[0].c_str());
+
+  point proto;
+  proto.outstanding = 0;
+  proto.target = 0.0;
+  proto.relative = false;
+  proto.max_seeds = seeds;
+  proto.finished = false;
+  proto.n = 0;
+  proto.mean = proto.half_width = 0.0;
+  if (!g.keys["ci"].empty()) {
+    const std::string &ci = g.keys["ci"][0];
+    proto.target = atof(ci.c_str());
+    proto.relative = ci[ci.size() - 1] == '%';
+    if (proto.relative) {
+      proto.target /= 100.0;
+    }
+    if (proto.target <= 0.0) {
+      fprintf(stderr, "Grid [%s] has an invalid ci\n", g.name.c_str());
+      exit(-1);
+    }
+    proto.max_seeds = g.keys["max_seeds"].empty()
+                          ? 100
+                          : atoi(g.keys["max_seeds"][0].c_str());
+    // An interval needs at least two runs
+    if (seeds < 2) {
+      seeds = 2;
+    }
+    if (proto.max_seeds < seeds) {
+      proto.max_seeds = seeds;
+    }
+  }
+
+  for (size_t p = 0; p < protocols.size(); p++)
+    for (size_t w = 0; w < windows.size(); w++)
+      for (size_t l = 0; l < losses.size(); l++)
+        for (size_t c = 0; c < corrupts.size(); c++)
+          for (size_t t = 0; t < times.size(); t++)
+            for (size_t m = 0; m < messages.size(); m++) {
+              cell x;
+              x.done = false;
+              x.grid = g.name;
+              x.protocol = protocols[p];
+              x.window = windows[w];
+              x.loss = losses[l];
+              x.corrupt = corrupts[c];
+              x.time = times[t];
+              x.messages = messages[m];
+              point pt = proto;
+              for (int s = 1; s <= seeds; s++) {
+                pt.cells.push_back(cells.size());
+                cells.push_back(with_seed(x, s));
+              }
+              points.push_back(pt);
+            }
+}
+
+/**
+ * Two-sided 95% quantile of Student's t distribution with df degrees of
+ * freedom.
+ */
+static double t_quantile(int df) {
+  static const double table[] = {
+      12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+      2.201,  2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+      2.080,  2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+  if (df <= 30) {
+    return table[df - 1];
+  }
+  // Cornish-Fisher expansion around the normal quantile
+  double z = 1.959964;
+  return z + (z * z * z + z) / (4.0 * df) +
+         (5 * pow(z, 5) + 16 * z * z * z + 3 * z) / (96.0 * df * df);
+}
+
+/**
+ * Recompute a configuration's mean throughput and confidence interval over
+ * its successful runs.
+ */
+static void summarise(point &pt, const std::vector<cell> &cells) {
+  double sum = 0.0, sumsq = 0.0;
+  pt.n = 0;
+  for (size_t i = 0; i < pt.cells.size(); i++) {
+    const cell &x = cells[pt.cells[i]];
+    if (x.done) {
+      sum += x.row.throughput;
+      sumsq += x.row.throughput * x.row.throughput;
+      pt.n++;
+    }
+  }
+  pt.mean = pt.n > 0 ? sum / pt.n : 0.0;
+  pt.half_width = 0.0;
+  if (pt.n > 1) {
+    double var = (sumsq - pt.n * pt.mean * pt.mean) / (pt.n - 1);
+    pt.half_width = t_quantile(pt.n - 1) * sqrt(var > 0.0 ? var : 0.0) /
+                    sqrt((double)pt.n);
+  }
+}
+
+/**
+ * Seeds a configuration should end up with, given the runs so far: the
+ * number the current variance estimate says reaches the target, capped
+ * at twice the runs so far (the estimate is rough while n is small) and
+ * at max_seeds. Returns the current count once the target is met.
+ */
+static int seeds_wanted(const point &pt) {
+  int have = pt.cells.size();
+  double target = pt.relative ? pt.target * pt.mean : pt.target;
+  if (pt.target == 0.0 || pt.n < 2 || pt.half_width <= target ||
+      have >= pt.max_seeds) {
+    return have;
+  }
+  // half_width scales with 1/sqrt(n)
+  double ratio = pt.half_width / target;
+  int want = (int)ceil(pt.n * ratio * ratio);
+  if (want > 2 * have) {
+    want = 2 * have;
+  }
+  if (want > pt.max_seeds) {
+    want = pt.max_seeds;
+  }
+  return want > have ? want : have + 1;
+}
+
+/**
+ * Command line arguments for a cell's run.
+ */
+static std::vector<std::string> command(const cell &x) {
+  char seed[16];
+  snprintf(seed, sizeof(seed), "%d", x.seed);
+  std::vector<std::string> args;
+  args.push_back(binary_path());
+  args.push_back("-P"); args.push_back(x.protocol);
+  args.push_back("-s"); args.push_back(seed);
+  args.push_back("-w"); args.push_back(x.window);
+  args.push_back("-m"); args.push_back(x.messages);
+  args.push_back("-l"); args.push_back(x.loss);
+  args.push_back("-c"); args.push_back(x.corrupt);
+  args.push_back("-t"); args.push_back(x.time);
+  args.push_back("-v"); args.push_back("0");
+  return args;
+}
+
+static std::string cache_path(const cell &x, const char *suffix) {
+  return std::string(cachedir) + "/" + x.key + suffix;
+}
+
+/**
+ * Load a run's row from a single-row results file.
+ */
+static bool load_row(const std::string &path, cell &x) {
+  results_reader *r = results_read_open(path.c_str());
+  if (r == NULL) {
+    return false;
+  }
+  x.done = results_next_group(r) == 1 && r->nrows == 1;
+  if (x.done) {
+    results_row(r, 0, &x.row);
+  }
+  results_read_close(r);
+  return x.done;
+}
+
+static bool read_cached(cell &x) { return load_row(cache_path(x, ".rcol"), x); }
+
+/**
+ * Load the row a finished run appended and move it into the cache.
+ */
+static bool collect(cell &x) {
+  std::string part = cache_path(x, ".part");
+  if (!load_row(part, x)) {
+    unlink(part.c_str());
+    return false;
+  }
+  rename(part.c_str(), cache_path(x, ".rcol").c_str());
+  return true;
+}
+
+static pid_t spawn(const cell &x) {
+  std::vector<std::string> args = command(x);
+  std::string part = cache_path(x, ".part");
+  unlink(part.c_str());
+  args.push_back("-o");
+  args.push_back(part);
+  pid_t pid = fork();
+  if (pid != 0) {
+    return pid;
+  }
+  int fd = open("/dev/null", O_WRONLY);
+  if (fd >= 0) {
+    dup2(fd, STDOUT_FILENO);
+    close(fd);
+  }
+  std::vector<char *> argv;
+  for (size_t i = 0; i < args.size(); i++) {
+    argv.push_back((char *)args[i].c_str());
+  }
+  argv.push_back(NULL);
+  execv(argv[0], &argv[0]);
+  _exit(127);
+}
+
+static void write_csv(const std::string &path, const std::vector<cell> &cells,
+                      const std::string &grid) {
+  FILE *f = fopen(path.c_str(), "w");
+  if (f == NULL) {
+    perror(path.c_str());
+    return;
+  }
+  fprintf(f, "Protocol,Window,Run,Messages,Loss,Corruption,Time_bw_messages,"
+             "Application_A,Transport_A,Transport_B,Application_B,Total_time,"
+             "Throughput\n");
+  for (size_t i = 0; i < cells.size(); i++) {
+    const cell &x = cells[i];
+    if (x.grid != grid || !x.done) {
+      continue;
+    }
+    fprintf(f, "%s,%s,%d,%s,%s,%s,%s,%d,%d,%d,%d,%f,%f\n", x.protocol.c_str(),
+            x.window.c_str(), x.seed, x.messages.c_str(), x.loss.c_str(),
+            x.corrupt.c_str(), x.time.c_str(), x.row.A_application,
+            x.row.A_transport, x.row.B_transport, x.row.B_application,
+            x.row.total_time, x.row.throughput);
+  }
+  fclose(f);
+}
+
+/**
+ * Write a grid's rows as one binary row group next to its CSV.
+ */
+static void write_rcol(const std::string &path, const std::vector<cell> &cells,
+                       const std::string &grid) {
+  unlink(path.c_str());
+  results_writer *w = results_open(path.c_str());
+  if (w == NULL) {
+    perror(path.c_str());
+    return;
+  }
+  for (size_t i = 0; i < cells.size(); i++) {
+    if (cells[i].grid == grid && cells[i].done) {
+      results_append(w, &cells[i].row);
+    }
+  }
+  if (!results_close(w)) {
+    fprintf(stderr, "Unable to write %s\n", path.c_str());
+  }
+}
+
+/**
+ * Compute a cell's cache key and load its row if cached.
+ *
+ * @return true if the cell came from the cache
+ */
+static bool prepare(cell &x) {
+  std::vector<std::string> args = command(x);
+  std::string line = "rdt";
+  for (size_t a = 1; a < args.size(); a++) {
+    line += " " + args[a];
+  }
+  line += " " + binary_version();
+  x.key = hex(fnv1a(line.data(), line.size(), 14695981039346656037ULL));
+  // Baselines time every run, so none can come from the cache
+  return baseline_in == NULL && baseline_out == NULL && read_cached(x);
+}
+
+/**
+ * Write each configuration's replicate count and throughput interval.
+ */
+static void write_summary(const std::string &path,
+                          const std::vector<point> &points,
+                          const std::vector<cell> &cells,
+                          const std::string &grid) {
+  FILE *f = fopen(path.c_str(), "w");
+  if (f == NULL) {
+    perror(path.c_str());
+    return;
+  }
+  fprintf(f, "Protocol,Window,Messages,Loss,Corruption,Time_bw_messages,"
+             "Replicates,Throughput_mean,Throughput_ci95,Target_ci95\n");
+  for (size_t i = 0; i < points.size(); i++) {
+    const point &pt = points[i];
+    const cell &x = cells[pt.cells[0]];
+    if (x.grid != grid) {
+      continue;
+    }
+    double target = pt.relative ? pt.target * pt.mean : pt.target;
+    fprintf(f, "%s,%s,%s,%s,%s,%s,%d,%f,%f,%f\n", x.protocol.c_str(),
+            x.window.c_str(), x.messages.c_str(), x.loss.c_str(),
+            x.corrupt.c_str(), x.time.c_str(), pt.n, pt.mean, pt.half_width,
+            target);
+  }
+  fclose(f);
+}
+
+/**
+ * A configuration's throughput and speed, as kept in a baseline.
+ */
+struct baseline {
+  int n;
+  double throughput, throughput_sd;
+  double speed, speed_sd; // Events per second of wall time
+};
+
+/**
+ * Name of a configuration in a baseline: its grid and parameters.
+ */
+static std::string config_key(const cell &x) {
+  return x.grid + "," + x.protocol + "," + x.window + "," + x.messages + "," +
+         x.loss + "," + x.corrupt + "," + x.time;
+}
+
+/**
+ * Mean and sample standard deviation.
+ */
+static void mean_sd(const std::vector<double> &v, double *mean, double *sd) {
+  double sum = 0.0, sumsq = 0.0;
+  for (size_t i = 0; i < v.size(); i++) {
+    sum += v[i];
+    sumsq += v[i] * v[i];
+  }
+  *mean = v.empty() ? 0.0 : sum / v.size();
+  double var = v.size() > 1 ? (sumsq - v.size() * *mean * *mean) /
+                                  (v.size() - 1)
+                            : 0.0;
+  *sd = sqrt(var > 0.0 ? var : 0.0);
+}
+
+/**
+ * Throughput and speed of a configuration over its successful runs.
+ */
+static baseline measure(const point &pt, const std::vector<cell> &cells) {
+  std::vector<double> throughput, speed;
+  baseline b;
+  for (size_t i = 0; i < pt.cells.size(); i++) {
+    const cell &x = cells[pt.cells[i]];
+    if (x.done) {
+      throughput.push_back(x.row.throughput);
+      speed.push_back(x.row.wall_time > 0.0 ? x.row.events / x.row.wall_time
+                                            : 0.0);
+    }
+  }
+  b.n = throughput.size();
+  mean_sd(throughput, &b.throughput, &b.throughput_sd);
+  mean_sd(speed, &b.speed, &b.speed_sd);
+  return b;
+}
+
+static void write_baseline(const char *path, const std::vector<point> &points,
+                           const std::vector<cell> &cells) {
+  FILE *f = fopen(path, "w");
+  if (f == NULL) {
+    perror(path);
+    exit(-1);
+  }
+  fprintf(f, "Grid,Protocol,Window,Messages,Loss,Corruption,Time_bw_messages,"
+             "Replicates,Throughput_mean,Throughput_sd,Events_per_sec_mean,"
+             "Events_per_sec_sd\n");
+  for (size_t i = 0; i < points.size(); i++) {
+    baseline b = measure(points[i], cells);
+    fprintf(f, "%s,%d,%.9g,%.9g,%.6g,%.6g\n",
+            config_key(cells[points[i].cells[0]]).c_str(), b.n, b.throughput,
+            b.throughput_sd, b.speed, b.speed_sd);
+  }
+  fclose(f);
+}
+
+static std::map<std::string, baseline> read_baseline(const char *path) {
+  std::map<std::string, baseline> out;
+  char line[1024];
+  FILE *f = fopen(path, "r");
+  if (f == NULL) {
+    perror(path);
+    exit(-1);
+  }
+  while (fgets(line, sizeof(line), f) != NULL) {
+    std::vector<std::string> w = split(line);
+    if (w.size() != 12 || w[0] == "Grid") {
+      continue;
+    }
+    baseline b;
+    b.n = atoi(w[7].c_str());
+    b.throughput = atof(w[8].c_str());
+    b.throughput_sd = atof(w[9].c_str());
+    b.speed = atof(w[10].c_str());
+    b.speed_sd = atof(w[11].c_str());
+    out[w[0] + "," + w[1] + "," + w[2] + "," + w[3] + "," + w[4] + "," + w[5] +
+        "," + w[6]] = b;
+  }
+  fclose(f);
+  return out;
+}
+
+/**
+ * Whether two means agree to the nine significant digits a baseline
+ * keeps.
+ */
+static bool same(double m0, double m1) {
+  return fabs(m1 - m0) <= 1e-8 * fabs(m0);
+}
+
+/**
+ * Welch's t-test of two means: whether they differ at the 95% level.
+ * Identical runs have no variance, so any difference between them counts.
+ */
+static bool significant(double m0, double sd0, int n0, double m1, double sd1,
+                        int n1) {
+  double v0 = sd0 * sd0 / n0, v1 = sd1 * sd1 / n1;
+  if (v0 + v1 == 0.0) {
+    return !same(m0, m1);
+  }
+  double df = (v0 + v1) * (v0 + v1) /
+              ((n0 > 1 ? v0 * v0 / (n0 - 1) : 0.0) +
+               (n1 > 1 ? v1 * v1 / (n1 - 1) : 0.0));
+  int dof = df >= 1.0 && df < 1e6 ? (int)df : 1000000;
+  return fabs(m1 - m0) / sqrt(v0 + v1) > t_quantile(dof < 1 ? 1 : dof);
+}
+
+static double change(double from, double to) {
+  return from != 0.0 ? 100.0 * (to - from) / from : 0.0;
+}
+
+/**
+ * Compare every configuration with the baseline and print the diff.
+ *
+ * @return the number of regressions
+ */
+static int compare_baseline(const char *path, const std::vector<point> &points,
+                            const std::vector<cell> &cells) {
+  std::map<std::string, baseline> base = read_baseline(path);
+  std::map<std::string, int> configs, slower, lower; // Per protocol
+  int regressions = 0, missing = 0;
+
+  printf("%-14s %-4s %6s %6s %5s %5s %6s %11s %11s %8s %11s %11s %8s  %s\n",
+         "grid", "prot", "window", "msgs", "loss", "corr", "time", "tput base",
+         "tput now", "change", "ev/s base", "ev/s now", "change", "verdict");
+  for (size_t i = 0; i < points.size(); i++) {
+    const cell &x = cells[points[i].cells[0]];
+    std::map<std::string, baseline>::iterator it = base.find(config_key(x));
+    configs[x.protocol]++;
+    if (it == base.end() || it->second.n == 0) {
+      missing++;
+      continue;
+    }
+    const baseline &b = it->second;
+    baseline now = measure(points[i], cells);
+    if (now.n == 0) {
+      continue;
+    }
+    std::string verdict;
+    bool tput = significant(b.throughput, b.throughput_sd, b.n,
+                            now.throughput, now.throughput_sd, now.n);
+    if (tput && now.throughput < b.throughput) {
+      verdict += " THROUGHPUT";
+      lower[x.protocol]++;
+      regressions++;
+    } else if (tput) {
+      verdict += " throughput up";
+    } else if (!same(b.throughput, now.throughput)) {
+      verdict += " throughput changed (n.s.)";
+    }
+    bool speed = significant(b.speed, b.speed_sd, b.n, now.speed, now.speed_sd,
+                             now.n) &&
+                 fabs(now.speed - b.speed) > speed_tolerance * b.speed;
+    if (speed && now.speed < b.speed) {
+      verdict += " SLOWER";
+      slower[x.protocol]++;
+      regressions++;
+    } else if (speed) {
+      verdict += " faster";
+    }
+    printf("%-14s %-4s %6s %6s %5s %5s %6s %11.6f %11.6f %7.2f%% %11.0f %11.0f "
+           "%7.1f%% %s\n",
+           x.grid.c_str(), x.protocol.c_str(), x.window.c_str(),
+           x.messages.c_str(), x.loss.c_str(), x.corrupt.c_str(),
+           x.time.c_str(), b.throughput, now.throughput,
+           change(b.throughput, now.throughput), b.speed, now.speed,
+           change(b.speed, now.speed), verdict.empty() ? " ok" : verdict.c_str());
+  }
+
+  printf("\n");
+  for (std::map<std::string, int>::iterator it = configs.begin();
+       it != configs.end(); ++it) {
+    printf("%s: %d configurations, %d with lower throughput, %d slower\n",
+           it->first.c_str(), it->second, lower[it->first],
+           slower[it->first]);
+  }
+  if (missing > 0) {
+    printf("%d configurations are not in %s\n", missing, path);
+  }
+  return regressions;
+}
+
+int main(int argc, char **argv) {
+  std::vector<cell> cells;
+  std::vector<point> points;
+  std::vector<size_t> owner; // Configuration of each cell
+  std::vector<size_t> pending;
+  std::map<pid_t, size_t> running;
+  int opt, ncached = 0, ncomputed = 0, nfailed = 0;
+
+  while ((opt = getopt(argc, argv, "j:b:C:B:U:e:")) != -1) {
+    switch (opt) {
+    case 'j': jobs = atoi(optarg); break;
+    case 'b': bindir = optarg; break;
+    case 'C': cachedir = optarg; break;
+    case 'B': baseline_in = optarg; break;
+    case 'U': baseline_out = optarg; break;
+    case 'e': speed_tolerance = atof(optarg); break;
+    default: usage(argv[0]); return -1;
+    }
+  }
+  if (optind != argc - 1) {
+    usage(argv[0]);
+    return -1;
+  }
+  if (jobs <= 0) {
+    jobs = sysconf(_SC_NPROCESSORS_ONLN);
+  }
+  if (mkdir(cachedir, 0755) < 0 && errno != EEXIST) {
+    perror(cachedir);
+    return -1;
+  }
+
+  std::vector<grid> grids = read_spec(argv[optind]);
+  for (size_t g = 0; g < grids.size(); g++) {
+    expand(grids[g], points, cells);
+  }
+  owner.resize(cells.size());
+  for (size_t p = 0; p < points.size(); p++) {
+    for (size_t c = 0; c < points[p].cells.size(); c++) {
+      owner[points[p].cells[c]] = p;
+      if (prepare(cells[points[p].cells[c]])) {
+        ncached++;
+      } else {
+        pending.push_back(points[p].cells[c]);
+        points[p].outstanding++;
+      }
+    }
+  }
+
+  size_t next = 0;
+  for (;;) {
+    // A configuration whose runs are all in either has its interval or
+    // gets more seeds; cached seeds count straight away.
+    for (size_t p = 0; p < points.size(); p++) {
+      point &pt = points[p];
+      while (!pt.finished && pt.outstanding == 0) {
+        summarise(pt, cells);
+        int want = seeds_wanted(pt);
+        if (want == (int)pt.cells.size()) {
+          pt.finished = true;
+          break;
+        }
+        cell base = cells[pt.cells[0]];
+        for (int s = pt.cells.size() + 1; s <= want; s++) {
+          size_t i = cells.size();
+          cells.push_back(with_seed(base, s));
+          owner.push_back(p);
+          pt.cells.push_back(i);
+          if (prepare(cells[i])) {
+            ncached++;
+          } else {
+            pending.push_back(i);
+            pt.outstanding++;
+          }
+        }
+      }
+    }
+
+    while (next < pending.size() && (int)running.size() < jobs) {
+      size_t i = pending[next++];
+      pid_t pid = spawn(cells[i]);
+      if (pid < 0) {
+        perror("fork");
+        points[owner[i]].outstanding--;
+        nfailed++;
+        continue;
+      }
+      running[pid] = i;
+    }
+    if (running.empty()) {
+      if (next < pending.size()) {
+        continue;
+      }
+      break;
+    }
+    int status;
+    pid_t pid = wait(&status);
+    if (pid < 0) {
+      break;
+    }
+    std::map<pid_t, size_t>::iterator it = running.find(pid);
+    if (it == running.end()) {
+      continue;
+    }
+    cell &x = cells[it->second];
+    points[owner[it->second]].outstanding--;
+    running.erase(it);
+    if (WIFEXITED(status) && WEXITSTATUS(status) == 0 && collect(x)) {
+      ncomputed++;
+    } else {
+      fprintf(stderr, "Run failed: %s seed %d (w %s l %s c %s t %s m %s)\n",
+              x.protocol.c_str(), x.seed, x.window.c_str(), x.loss.c_str(),
+              x.corrupt.c_str(), x.time.c_str(), x.messages.c_str());
+      nfailed++;
+    }
+  }
+
+  for (size_t g = 0; g < grids.size(); g++) {
+    std::vector<std::string> &output = grids[g].keys["output"];
+    std::string path = output.empty() ? grids[g].name + ".csv" : output[0];
+    write_csv(path, cells, grids[g].name);
+    std::string base = path.substr(0, path.rfind(".csv"));
+    write_rcol(base + ".rcol", cells, grids[g].name);
+    write_summary(base + "-summary.csv", points, cells, grids[g].name);
+  }
+  printf("%d cells: %d cached, %d computed, %d failed\n", (int)cells.size(),
+         ncached, ncomputed, nfailed);
+
+  int regressions = 0;
+  if (baseline_out != NULL) {
+    write_baseline(baseline_out, points, cells);
+  }
+  if (baseline_in != NULL) {
+    printf("\n");
+    regressions = compare_baseline(baseline_in, points, cells);
+  }
+  return nfailed == 0 && regressions == 0 ? 0 : 1;
+}
@@ -0,0 +1,303 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <queue>
+#include <vector>
+
+#include "../include/realtime.h"
+#include "../include/spsc_ring.h"
+
+/*
+ * Threaded real-time runtime.
+ *
+ * Entity A and entity B each run on their own thread, pinned to a CPU
+ * (-A and -B, by default CPUs 0 and 1 modulo the number online). Each
+ * thread owns a timer heap holding its entity's timer and, for A, the
+ * layer 5 arrival schedule, and runs its own event loop on the monotonic
+ * clock. The threads exchange packets through lock-free SPSC rings. The
+ * sending side applies the emulator's loss/corruption model and stamps
+ * each packet with a delivery time 1 to 10 time units after the latest
+ * one already in flight, as the emulator's FIFO medium does (-n turns the
+ * emulated delay off). The receiving side delivers a packet once that
+ * time has passed.
+ *
+ * Both entities are initialised on the main thread before the workers
+ * start, so A_init/B_init need no synchronisation with the event loops.
+ */
+
+#define A 0
+#define B 1
+
+#define RING_SIZE 4096 // Packets in flight per direction
+
+/* Timer heap entry kinds */
+#define TIMER_INTERRUPT 0
+#define FROM_LAYER5 1
+
+/**
+ * A packet in flight between the threads.
+ */
+struct rt_slot {
+  uint64_t sent_ns;    // When the sender handed it to tolayer3
+  uint64_t deliver_ns; // When the medium lets it out at the receiver
+  struct pkt packet;
+};
+
+/**
+ * An entry in an entity's timer heap.
+ */
+struct rt_timer {
+  uint64_t when;
+  int kind;
+  unsigned int gen; // Matches entity::timer_gen unless since stopped
+
+  bool operator>(const rt_timer &other) const { return when > other.when; }
+};
+
+/**
+ * Per-thread entity state.
+ */
+struct entity {
+  int cpu;
+  std::priority_queue<rt_timer, std::vector<rt_timer>,
+                      std::greater<rt_timer> >
+      heap;
+  bool timer_running;
+  unsigned int timer_gen;
+  unsigned int rng;      // Impairment and arrival random state
+  uint64_t last_deliver; // Latest delivery time of packets this entity sent
+  struct rt_latency e2e;  // Send to delivery, including emulated delay
+  struct rt_latency late; // Delivery past the emulated arrival time
+  int nlost;
+  int nfull;
+};
+
+static struct entity ent[2];
+static spsc_ring<rt_slot, RING_SIZE> rings[2]; // rings[e] carries packets to e
+static std::atomic<int> done;
+static bool emulate_delay = true; // -n turns this off
+static int nsim = 0;              // Messages handed to A so far
+
+static void handle_opt(int opt, char *arg) {
+  switch (opt) {
+  case 'A': ent[A].cpu = atoi(arg); break;
+  case 'B': ent[B].cpu = atoi(arg); break;
+  case 'n': emulate_delay = false; break;
+  }
+}
+
+static void record(struct rt_latency *latency, uint64_t ns) {
+  latency->count++;
+  latency->sum += ns;
+  if (latency->count == 1 || ns < latency->min) {
+    latency->min = ns;
+  }
+  if (ns > latency->max) {
+    latency->max = ns;
+  }
+}
+
+static void pin(int cpu) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu % sysconf(_SC_NPROCESSORS_ONLN), &set);
+  if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+    fprintf(stderr, "Warning: unable to pin thread to CPU %d\n", cpu);
+  }
+}
+
+/**
+ * Deliver every inbound packet whose arrival time has passed.
+ */
+static int receive(int self, uint64_t now) {
+  struct entity *e = &ent[self];
+  struct rt_slot *slot;
+  int n = 0;
+
+  while ((slot = rings[self].front()) != NULL && slot->deliver_ns <= now) {
+    struct pkt packet = slot->packet;
+    record(&e->e2e, now - slot->sent_ns);
+    record(&e->late, now - slot->deliver_ns);
+    rings[self].pop();
+    if (self == A) {
+      rtcfg.proto->A_input(packet);
+    } else {
+      B_transport += 1;
+      rtcfg.proto->B_input(packet);
+    }
+    n++;
+  }
+  return n;
+}
+
+/**
+ * Run every heap entry that is due.
+ */
+static int expire(int self, uint64_t now) {
+  struct entity *e = &ent[self];
+  struct msg message;
+  int n = 0;
+
+  while (!e->heap.empty() && e->heap.top().when <= now) {
+    rt_timer t = e->heap.top();
+    e->heap.pop();
+    if (t.kind == FROM_LAYER5) {
+      if (nsim < rtcfg.nsimmax) {
+        rt_make_msg(nsim, &message);
+        nsim++;
+        A_application += 1;
+        rtcfg.proto->A_output(message);
+      }
+      if (nsim < rtcfg.nsimmax) {
+        rt_timer next = {t.when + rt_units_to_ns(rt_next_gap(&e->rng)),
+                         FROM_LAYER5, 0};
+        e->heap.push(next);
+      }
+    } else if (t.gen == e->timer_gen && e->timer_running) {
+      e->timer_running = false;
+      if (self == A) {
+        rtcfg.proto->A_timerinterrupt();
+      }
+    }
+    n++;
+  }
+  return n;
+}
+
+static void *run_A(void *arg) {
+  uint64_t deadline = 0;
+
+  pin(ent[A].cpu);
+  while (1) {
+    uint64_t now = rt_now_ns();
+    int work = receive(A, now) + expire(A, now);
+    if (nsim == rtcfg.nsimmax) {
+      if (rtcfg.grace <= 0.0) {
+        break; // all done, as in the emulator
+      }
+      if (deadline == 0) {
+        deadline = now + rt_units_to_ns(rtcfg.grace);
+      } else if (now >= deadline) {
+        break;
+      }
+    }
+    if (work == 0) {
+      sched_yield();
+    }
+  }
+  done.store(1, std::memory_order_release);
+  return NULL;
+}
+
+static void *run_B(void *arg) {
+  pin(ent[B].cpu);
+  while (!done.load(std::memory_order_acquire)) {
+    uint64_t now = rt_now_ns();
+    if (receive(B, now) + expire(B, now) == 0) {
+      sched_yield();
+    }
+  }
+  return NULL;
+}
+
+static void print_latency(const char *what, const struct rt_latency *latency) {
+  if (latency->count == 0) {
+    return;
+  }
+  printf(" %s: mean %llu ns, min %llu ns, max %llu ns over %llu packets\n",
+         what, (unsigned long long)(latency->sum / latency->count),
+         (unsigned long long)latency->min, (unsigned long long)latency->max,
+         (unsigned long long)latency->count);
+}
+
+int main(int argc, char **argv) {
+  pthread_t threads[2];
+
+  ent[A].cpu = 0;
+  ent[B].cpu = 1;
+  rt_parse_args(argc, argv, "A:B:n", handle_opt);
+  ent[A].rng = rtcfg.seed;
+  ent[B].rng = rtcfg.seed + 1;
+  rings[A].init();
+  rings[B].init();
+  done.store(0);
+
+  rt_start();
+  rtcfg.proto->A_init();
+  rtcfg.proto->B_init();
+  rt_timer first = {rt_now_ns() + rt_units_to_ns(rt_next_gap(&ent[A].rng)),
+                    FROM_LAYER5, 0};
+  ent[A].heap.push(first);
+
+  pthread_create(&threads[A], NULL, run_A, NULL);
+  pthread_create(&threads[B], NULL, run_B, NULL);
+  pthread_join(threads[A], NULL);
+  pthread_join(threads[B], NULL);
+
+  rt_latency_merge(&ent[B].e2e);
+  rt_latency_merge(&ent[A].e2e);
+  rt_report("Threaded");
+  print_latency("A->B end-to-end latency", &ent[B].e2e);
+  print_latency("B->A end-to-end latency", &ent[A].e2e);
+  print_latency("A->B delivery lateness", &ent[B].late);
+  print_latency("B->A delivery lateness", &ent[A].late);
+  printf(" Drops: %d lost, %d ring full at A; %d lost, %d ring full at B\n",
+         ent[A].nlost, ent[A].nfull, ent[B].nlost, ent[B].nfull);
+  return 0;
+}
+
+/********************** Student-callable ROUTINES ***********************/
+
+void starttimer(int AorB, float increment) {
+  struct entity *e = &ent[AorB];
+  if (e->timer_running) {
+    printf("Warning: attempt to start a timer that is already started\n");
+    return;
+  }
+  e->timer_running = true;
+  rt_timer t = {rt_now_ns() + rt_units_to_ns(increment), TIMER_INTERRUPT,
+                ++e->timer_gen};
+  e->heap.push(t);
+}
+
+void stoptimer(int AorB) {
+  struct entity *e = &ent[AorB];
+  if (!e->timer_running) {
+    printf("Warning: unable to cancel your timer. It wasn't running.\n");
+    return;
+  }
+  // Leave the heap entry in place; the generation bump makes it stale.
+  e->timer_running = false;
+  e->timer_gen++;
+}
+
+void tolayer3(int AorB, struct pkt packet) {
+  struct entity *e = &ent[AorB];
+  struct rt_slot slot;
+  uint64_t now = rt_now_ns();
+
+  if (AorB == A) {
+    A_transport += 1;
+  }
+  if (!rt_impair(&packet, &e->rng)) {
+    e->nlost++;
+    return;
+  }
+  slot.sent_ns = now;
+  slot.deliver_ns = now;
+  if (emulate_delay) {
+    if (e->last_deliver > now) {
+      slot.deliver_ns = e->last_deliver;
+    }
+    slot.deliver_ns += rt_units_to_ns(1 + 9 * rt_rand(&e->rng));
+  }
+  slot.packet = packet;
+  if (!rings[(AorB + 1) % 2].push(slot)) {
+    e->nfull++;
+    return;
+  }
+  e->last_deliver = slot.deliver_ns;
+}
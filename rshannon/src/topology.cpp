@@ -0,0 +1,218 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#include "../include/topology.h"
+
+#define MAX_LINE 1024
+
+/**
+ * Number of a node, adding it if it is new.
+ */
+static int node_number(struct topology *t, const char *name) {
+  for (size_t i = 0; i < t->nodes.size(); i++) {
+    if (t->nodes[i] == name) {
+      return (int)i;
+    }
+  }
+  t->nodes.push_back(name);
+  return (int)t->nodes.size() - 1;
+}
+
+/**
+ * Parse a non-negative number, a probability if max is 1.
+ */
+static bool parse_value(const char *text, float max, float *value) {
+  char *end;
+  double v = strtod(text, &end);
+  if (end == text || *end != '\0' || v < 0.0 || v > max) {
+    return false;
+  }
+  *value = (float)v;
+  return true;
+}
+
+/**
+ * Set one key=value parameter of a link.
+ */
+static bool parse_param(struct topo_link *link, char *param) {
+  char *eq = strchr(param, '=');
+  float value;
+  if (eq == NULL) {
+    return false;
+  }
+  *eq = '\0';
+  const char *key = param, *text = eq + 1;
+  if (strcmp(key, "delay") == 0) {
+    return parse_value(text, 1e9, &link->delay);
+  } else if (strcmp(key, "jitter") == 0) {
+    return parse_value(text, 1e9, &link->jitter);
+  } else if (strcmp(key, "loss") == 0) {
+    return parse_value(text, 1.0, &link->loss);
+  } else if (strcmp(key, "corrupt") == 0) {
+    return parse_value(text, 1.0, &link->corrupt);
+  } else if (strcmp(key, "service") == 0) {
+    return parse_value(text, 1e9, &link->service);
+  } else if (strcmp(key, "queue") == 0) {
+    if (!parse_value(text, 1e9, &value) || value != (int)value) {
+      return false;
+    }
+    link->queue = (int)value;
+    return true;
+  }
+  return false;
+}
+
+/**
+ * Fill in route[host]: a breadth-first search out from host, each node
+ * taking the first link that reaches it.
+ */
+static void find_routes(struct topology *t, int host) {
+  std::vector<int> &route = t->route[host];
+  std::deque<int> frontier;
+  std::vector<bool> seen(t->nodes.size(), false);
+
+  route.assign(t->nodes.size(), -1);
+  seen[host] = true;
+  frontier.push_back(host);
+  while (!frontier.empty()) {
+    int node = frontier.front();
+    frontier.pop_front();
+    for (size_t i = 0; i < t->links.size(); i++) {
+      const topo_link &link = t->links[i];
+      if (link.to == node && !seen[link.from]) {
+        seen[link.from] = true;
+        route[link.from] = (int)i;
+        frontier.push_back(link.from);
+      }
+    }
+  }
+}
+
+bool topo_load(struct topology *t, const char *path) {
+  char line[MAX_LINE];
+  int lineno = 0;
+
+  FILE *f = fopen(path, "r");
+  if (f == NULL) {
+    perror(path);
+    return false;
+  }
+  t->nodes.clear();
+  t->links.clear();
+  node_number(t, "A");
+  node_number(t, "B");
+  while (fgets(line, sizeof(line), f) != NULL) {
+    lineno++;
+    char *hash = strchr(line, '#');
+    if (hash != NULL) {
+      *hash = '\0';
+    }
+    char *word = strtok(line, " \t\r\n");
+    if (word == NULL) {
+      continue;
+    }
+    char *from = strtok(NULL, " \t\r\n"), *to = strtok(NULL, " \t\r\n");
+    if (strcmp(word, "link") != 0 || from == NULL || to == NULL) {
+      fprintf(stderr, "%s:%d: expected link node node [key=value ...]\n",
+              path, lineno);
+      fclose(f);
+      return false;
+    }
+    if (strcmp(from, to) == 0) {
+      fprintf(stderr, "%s:%d: link from %s to itself\n", path, lineno, from);
+      fclose(f);
+      return false;
+    }
+    topo_link link = {};
+    link.delay = 1.0;
+    for (char *param = strtok(NULL, " \t\r\n"); param != NULL;
+         param = strtok(NULL, " \t\r\n")) {
+      std::string text(param);
+      if (!parse_param(&link, param)) {
+        fprintf(stderr, "%s:%d: invalid parameter %s\n", path, lineno,
+                text.c_str());
+        fclose(f);
+        return false;
+      }
+    }
+    link.from = node_number(t, from);
+    link.to = node_number(t, to);
+    t->links.push_back(link);
+    std::swap(link.from, link.to);
+    t->links.push_back(link);
+  }
+  fclose(f);
+
+  find_routes(t, TOPO_A);
+  find_routes(t, TOPO_B);
+  if (t->route[TOPO_B][TOPO_A] < 0) {
+    fprintf(stderr, "%s: no route between A and B\n", path);
+    return false;
+  }
+  return true;
+}
+
+struct topo_link *topo_next(struct topology *t, int node, int host) {
+  return &t->links[t->route[host][node]];
+}
+
+int topo_hops(const struct topology *t, int host) {
+  int hops = 0;
+  for (int node = 1 - host; node != host; hops++) {
+    node = t->links[t->route[host][node]].to;
+  }
+  return hops;
+}
+
+bool topo_enqueue(struct topo_link *link, float now, float *depart) {
+  while (!link->departures.empty() && link->departures.front() <= now) {
+    link->departures.pop_front();
+  }
+  // Everything it holds but the packet being sent is waiting
+  int waiting = link->departures.empty() ? 0 : link->departures.size() - 1;
+  link->offered++;
+  link->queuesum += waiting;
+  if (link->queue > 0 && waiting >= link->queue) {
+    link->dropped++;
+    return false;
+  }
+  float start = now;
+  if (!link->departures.empty()) {
+    // It waits behind the others
+    start = link->departures.back();
+    link->maxqueue = std::max(link->maxqueue, waiting + 1);
+  }
+  *depart = start + link->service;
+  if (link->service > 0.0) {
+    link->departures.push_back(*depart);
+  }
+  return true;
+}
+
+int topo_dropped(const struct topology *t) {
+  int dropped = 0;
+  for (size_t i = 0; i < t->links.size(); i++) {
+    dropped += t->links[i].dropped;
+  }
+  return dropped;
+}
+
+void topo_report(const struct topology *t) {
+  for (int host = TOPO_B; host >= TOPO_A; host--) {
+    int hops = topo_hops(t, host);
+    printf(" Route %s to %s, %d hop%s:\n", t->nodes[1 - host].c_str(),
+           t->nodes[host].c_str(), hops, hops == 1 ? "" : "s");
+    for (int node = 1 - host; node != host;) {
+      const topo_link &link = t->links[t->route[host][node]];
+      printf("  %s->%s: %d packets, %d lost, %d corrupted, %d dropped by a "
+             "full queue; queue mean %f, max %d\n",
+             t->nodes[link.from].c_str(), t->nodes[link.to].c_str(),
+             link.offered, link.lost, link.corrupted, link.dropped,
+             link.offered > 0 ? link.queuesum / link.offered : 0.0,
+             link.maxqueue);
+      node = link.to;
+    }
+  }
+}
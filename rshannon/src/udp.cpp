@@ -0,0 +1,329 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+#include "../include/realtime.h"
+
+/*
+ * UDP loopback runtime.
+ *
+ * Entities A and B each own a UDP socket bound to 127.0.0.1. tolayer3()
+ * queues packets on the sending entity's batch, which is flushed with one
+ * sendmmsg() per loop iteration; inbound packets are drained with
+ * recvmmsg(). Timers and layer 5 arrivals are timerfds, and everything is
+ * multiplexed on a single epoll instance, so A and B share one thread just
+ * as they do in the emulator and the protocol code needs no locking.
+ *
+ * Loss and corruption are injected in userspace before a packet is queued,
+ * with the same -l/-c semantics as the emulator. The medium itself is the
+ * kernel loopback path, so there is no emulated propagation delay.
+ */
+
+#define A 0
+#define B 1
+
+#define BATCH_SIZE 64 // Packets moved per sendmmsg/recvmmsg call
+
+/**
+ * What goes on the wire: the protocol's packet, prefixed with the
+ * monotonic send time so the receiver can account latency.
+ */
+struct wire_pkt {
+  uint64_t sent_ns;
+  struct pkt packet;
+};
+
+/**
+ * Outbound batch of one entity.
+ */
+struct out_batch {
+  struct wire_pkt bufs[BATCH_SIZE];
+  struct iovec iovs[BATCH_SIZE];
+  struct mmsghdr hdrs[BATCH_SIZE];
+  int count;
+};
+
+static int sock[2];              // UDP socket of each entity
+static struct sockaddr_in addr[2]; // Bound address of each entity
+static int timer_fd[2];          // Timer of each entity
+static bool timer_running[2];    // Whether the entity's timer is armed
+static int arrival_fd;           // Next layer 5 arrival at A
+static struct out_batch out[2];  // Packets queued by each entity
+static unsigned int rng;         // Impairment and arrival random state
+
+static int nsim = 0;             // Messages handed to A so far
+static int nbatches = 0;         // sendmmsg calls made
+static int nlost = 0;            // Packets dropped in userspace
+static int nsendfail = 0;        // Packets the kernel would not take
+
+static void die(const char *what) {
+  perror(what);
+  exit(-1);
+}
+
+static void arm(int fd, uint64_t ns, bool absolute) {
+  struct itimerspec its = {};
+  its.it_value.tv_sec = ns / 1000000000ULL;
+  its.it_value.tv_nsec = ns % 1000000000ULL;
+  if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0) {
+    its.it_value.tv_nsec = 1; // A zero value would disarm the timer
+  }
+  if (timerfd_settime(fd, absolute ? TFD_TIMER_ABSTIME : 0, &its, NULL) < 0) {
+    die("timerfd_settime");
+  }
+}
+
+static void disarm(int fd) {
+  struct itimerspec its = {};
+  if (timerfd_settime(fd, 0, &its, NULL) < 0) {
+    die("timerfd_settime");
+  }
+}
+
+static uint64_t drain(int fd) {
+  uint64_t expirations = 0;
+  if (read(fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN) {
+    die("read timerfd");
+  }
+  return expirations;
+}
+
+static void open_entity(int e, int ep) {
+  struct epoll_event ev = {};
+  socklen_t len = sizeof(addr[e]);
+  int bufsize = 4 << 20;
+
+  if ((sock[e] = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0)) < 0) {
+    die("socket");
+  }
+  setsockopt(sock[e], SOL_SOCKET, SO_RCVBUF, &bufsize, sizeof(bufsize));
+  setsockopt(sock[e], SOL_SOCKET, SO_SNDBUF, &bufsize, sizeof(bufsize));
+  addr[e].sin_family = AF_INET;
+  addr[e].sin_port = 0; // Let the kernel pick
+  addr[e].sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(sock[e], (struct sockaddr *)&addr[e], sizeof(addr[e])) < 0) {
+    die("bind");
+  }
+  getsockname(sock[e], (struct sockaddr *)&addr[e], &len);
+
+  if ((timer_fd[e] = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK)) < 0) {
+    die("timerfd_create");
+  }
+
+  ev.events = EPOLLIN;
+  ev.data.fd = sock[e];
+  epoll_ctl(ep, EPOLL_CTL_ADD, sock[e], &ev);
+  ev.data.fd = timer_fd[e];
+  epoll_ctl(ep, EPOLL_CTL_ADD, timer_fd[e], &ev);
+}
+
+/**
+ * Send everything entity e has queued with a single syscall.
+ */
+static void flush(int e) {
+  struct out_batch *batch = &out[e];
+  int sent = 0;
+
+  while (sent < batch->count) {
+    int n = sendmmsg(sock[e], batch->hdrs + sent, batch->count - sent, 0);
+    nbatches++;
+    if (n < 0) {
+      // Socket buffer full: the loopback "medium" drops the rest.
+      nsendfail += batch->count - sent;
+      break;
+    }
+    sent += n;
+  }
+  batch->count = 0;
+}
+
+/**
+ * Receive and deliver everything pending on entity e's socket.
+ */
+static void receive(int e) {
+  struct wire_pkt bufs[BATCH_SIZE];
+  struct iovec iovs[BATCH_SIZE];
+  struct mmsghdr hdrs[BATCH_SIZE];
+  int n;
+
+  memset(hdrs, 0, sizeof(hdrs));
+  for (int i = 0; i < BATCH_SIZE; i++) {
+    iovs[i].iov_base = &bufs[i];
+    iovs[i].iov_len = sizeof(bufs[i]);
+    hdrs[i].msg_hdr.msg_iov = &iovs[i];
+    hdrs[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  while ((n = recvmmsg(sock[e], hdrs, BATCH_SIZE, MSG_DONTWAIT, NULL)) > 0) {
+    uint64_t now = rt_now_ns();
+    for (int i = 0; i < n; i++) {
+      if (hdrs[i].msg_len != sizeof(struct wire_pkt)) {
+        continue;
+      }
+      rt_record_latency(now - bufs[i].sent_ns);
+      if (e == A) {
+        rtcfg.proto->A_input(bufs[i].packet);
+      } else {
+        B_transport += 1;
+        rtcfg.proto->B_input(bufs[i].packet);
+      }
+    }
+    if (n < BATCH_SIZE) {
+      break;
+    }
+  }
+}
+
+/**
+ * Hand over every layer 5 message that is due, then schedule the next one.
+ */
+static void arrivals(uint64_t *next_arrival) {
+  struct msg message;
+
+  drain(arrival_fd);
+  while (nsim < rtcfg.nsimmax && *next_arrival <= rt_now_ns()) {
+    rt_make_msg(nsim, &message);
+    nsim++;
+    A_application += 1;
+    rtcfg.proto->A_output(message);
+    *next_arrival += rt_units_to_ns(rt_next_gap(&rng));
+  }
+  if (nsim < rtcfg.nsimmax) {
+    arm(arrival_fd, *next_arrival, true);
+  }
+}
+
+int main(int argc, char **argv) {
+  struct epoll_event events[8];
+  struct epoll_event ev = {};
+  uint64_t next_arrival, deadline = 0;
+  int ep;
+
+  rt_parse_args(argc, argv, "", NULL);
+  rng = rtcfg.seed;
+
+  if ((ep = epoll_create1(0)) < 0) {
+    die("epoll_create1");
+  }
+  open_entity(A, ep);
+  open_entity(B, ep);
+  for (int e = A; e <= B; e++) {
+    int peer = (e + 1) % 2;
+    for (int i = 0; i < BATCH_SIZE; i++) {
+      out[e].iovs[i].iov_base = &out[e].bufs[i];
+      out[e].iovs[i].iov_len = sizeof(struct wire_pkt);
+      out[e].hdrs[i].msg_hdr.msg_name = &addr[peer];
+      out[e].hdrs[i].msg_hdr.msg_namelen = sizeof(addr[peer]);
+      out[e].hdrs[i].msg_hdr.msg_iov = &out[e].iovs[i];
+      out[e].hdrs[i].msg_hdr.msg_iovlen = 1;
+    }
+  }
+  if ((arrival_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK)) < 0) {
+    die("timerfd_create");
+  }
+  ev.events = EPOLLIN;
+  ev.data.fd = arrival_fd;
+  epoll_ctl(ep, EPOLL_CTL_ADD, arrival_fd, &ev);
+
+  rt_start();
+  rtcfg.proto->A_init();
+  rtcfg.proto->B_init();
+  flush(A);
+  flush(B);
+
+  next_arrival = rt_now_ns() + rt_units_to_ns(rt_next_gap(&rng));
+  arm(arrival_fd, next_arrival, true);
+
+  while (1) {
+    int timeout = -1;
+    if (deadline != 0) {
+      uint64_t now = rt_now_ns();
+      if (now >= deadline) {
+        break;
+      }
+      timeout = (deadline - now) / 1000000 + 1;
+    }
+    int n = epoll_wait(ep, events, 8, timeout);
+    if (n < 0 && errno != EINTR) {
+      die("epoll_wait");
+    }
+    for (int i = 0; i < n; i++) {
+      int fd = events[i].data.fd;
+      if (fd == sock[A]) {
+        receive(A);
+      } else if (fd == sock[B]) {
+        receive(B);
+      } else if (fd == arrival_fd) {
+        arrivals(&next_arrival);
+      } else {
+        int e = (fd == timer_fd[A]) ? A : B;
+        if (drain(fd) > 0 && timer_running[e]) {
+          timer_running[e] = false;
+          if (e == A) {
+            rtcfg.proto->A_timerinterrupt();
+          }
+        }
+      }
+    }
+    flush(A);
+    flush(B);
+    if (nsim == rtcfg.nsimmax && deadline == 0) {
+      if (rtcfg.grace <= 0.0) {
+        break; // all done, as in the emulator
+      }
+      deadline = rt_now_ns() + rt_units_to_ns(rtcfg.grace);
+    }
+  }
+
+  rt_report("UDP loopback");
+  printf(" Datagrams: %d lost in userspace, %d dropped by the kernel, "
+         "%d sendmmsg calls (%f packets per call)\n",
+         nlost, nsendfail, nbatches,
+         nbatches > 0 ? (float)(A_transport - nlost) / nbatches : 0.0);
+  return 0;
+}
+
+/********************** Student-callable ROUTINES ***********************/
+
+void starttimer(int AorB, float increment) {
+  if (timer_running[AorB]) {
+    printf("Warning: attempt to start a timer that is already started\n");
+    return;
+  }
+  arm(timer_fd[AorB], rt_units_to_ns(increment), false);
+  timer_running[AorB] = true;
+}
+
+void stoptimer(int AorB) {
+  if (!timer_running[AorB]) {
+    printf("Warning: unable to cancel your timer. It wasn't running.\n");
+    return;
+  }
+  disarm(timer_fd[AorB]);
+  timer_running[AorB] = false;
+}
+
+void tolayer3(int AorB, struct pkt packet) {
+  struct out_batch *batch = &out[AorB];
+
+  if (AorB == A) {
+    A_transport += 1;
+  }
+  if (!rt_impair(&packet, &rng)) {
+    nlost++;
+    return;
+  }
+  if (batch->count == BATCH_SIZE) {
+    flush(AorB);
+  }
+  batch->bufs[batch->count].sent_ns = rt_now_ns();
+  batch->bufs[batch->count].packet = packet;
+  batch->count++;
+}
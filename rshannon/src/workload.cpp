@@ -0,0 +1,64 @@
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../include/workload.h"
+
+bool workload_open(struct workload *w, const char *path) {
+  struct stat st;
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  if (fstat(fd, &st) < 0) {
+    close(fd);
+    return false;
+  }
+  if (st.st_size < (off_t)sizeof(workload_header)) {
+    close(fd);
+    errno = EINVAL;
+    return false;
+  }
+  void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) {
+    return false;
+  }
+  const struct workload_header *h = (const struct workload_header *)p;
+  uint64_t room = (st.st_size - sizeof(workload_header)) /
+                  sizeof(workload_record);
+  if (h->magic != WORKLOAD_MAGIC || h->version != WORKLOAD_VERSION ||
+      h->count > room) {
+    munmap(p, st.st_size);
+    errno = EINVAL;
+    return false;
+  }
+  // A replay reads it front to back, once
+  madvise(p, st.st_size, MADV_SEQUENTIAL);
+  w->records = (const struct workload_record *)(h + 1);
+  w->count = h->count;
+  w->map = p;
+  w->size = st.st_size;
+  return true;
+}
+
+void workload_close(struct workload *w) {
+  munmap(w->map, w->size);
+  w->records = NULL;
+  w->count = 0;
+}
+
+bool workload_save(const char *path, const struct workload_record *records,
+                   uint64_t count) {
+  FILE *f = fopen(path, "wb");
+  if (f == NULL) {
+    return false;
+  }
+  struct workload_header h = {WORKLOAD_MAGIC, WORKLOAD_VERSION, count};
+  bool ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+            fwrite(records, sizeof(*records), count, f) == count;
+  return fclose(f) == 0 && ok;
+}
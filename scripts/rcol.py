@@ -0,0 +1,71 @@
+"""
+Reader for the binary columnar results files written by the simulator's
+-o option and by rshannon/sweep (format described in
+rshannon/include/results.h).
+
+	import rcol
+	for group in rcol.groups("exp1-gbn-sr.rcol"):
+		print(group["protocol"], group["throughput"])
+
+Each group is a dict of column name -> list of values. rcol.columns()
+concatenates every group of a file into one such dict.
+"""
+import struct
+import sys
+
+MAGIC = b"RCOL"
+VERSION = 1
+TYPES = {
+	0: ("<i", 4),	# int32
+	1: ("<d", 8),	# double
+	2: (None, 8),	# char[8]
+}
+
+def _read(f, n):
+	data = f.read(n)
+	if len(data) != n:
+		raise ValueError("truncated results file")
+	return data
+
+def groups(path):
+	"""Yield each row group of a results file as a dict of columns."""
+	with open(path, "rb") as f:
+		while True:
+			magic = f.read(4)
+			if not magic:
+				return
+			if magic != MAGIC:
+				raise ValueError("not a results file: %s" % path)
+			version, ncols, nrows = struct.unpack("<HHI", _read(f, 8))
+			if version != VERSION:
+				raise ValueError("unsupported results version %d" % version)
+			schema = []
+			for _ in range(ncols):
+				type, length = struct.unpack("<BB", _read(f, 2))
+				schema.append((_read(f, length).decode(), type))
+			group = {}
+			for name, type in schema:
+				fmt, size = TYPES[type]
+				data = _read(f, size * nrows)
+				if fmt is None:
+					group[name] = [data[i:i + size].rstrip(b"\0").decode()
+					               for i in range(0, len(data), size)]
+				else:
+					group[name] = [v[0] for v in struct.iter_unpack(fmt, data)]
+			yield group
+
+def columns(path):
+	"""Every group of a results file concatenated into one dict."""
+	result = {}
+	for group in groups(path):
+		for name, values in group.items():
+			result.setdefault(name, []).extend(values)
+	return result
+
+if __name__ == "__main__":
+	# Dump a results file as CSV.
+	for group in groups(sys.argv[1]):
+		names = list(group.keys())
+		print(",".join(names))
+		for row in zip(*[group[n] for n in names]):
+			print(",".join(str(v) for v in row))